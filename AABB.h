@@ -6,25 +6,53 @@
 #include "Interval.h"
 #include <algorithm>
 
-class AABB
+template <typename Scalar>
+class AABBT
 {
 public:
-    AABB() {}
-    AABB(const Point3 &min, const Point3 &max) : min_(min), max_(max) {}
-    const Point3 &min() const { return min_; }
-    const Point3 &max() const { return max_; }
+    using Point = Vector3T<Scalar>;
 
-    bool hit(const Ray &ray, Interval rayInterval) const
+    AABBT() {}
+    AABBT(const Point &min, const Point &max) : min_(min), max_(max) {}
+    const Point &min() const { return min_; }
+    const Point &max() const { return max_; }
+
+    Point centroid() const { return (min_ + max_) * Scalar(0.5); }
+
+    Scalar surfaceArea() const
+    {
+        Point extent = max_ - min_;
+        if (extent.x() < 0 || extent.y() < 0 || extent.z() < 0)
+            return 0; // Empty box
+        return 2 * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+    }
+
+    // Axis (0, 1 or 2) along which the box is widest
+    int longestAxis() const
     {
-        double intervalMin = rayInterval.min();
-        double intervalMax = rayInterval.max();
+        Point extent = max_ - min_;
+        if (extent.x() > extent.y())
+            return extent.x() > extent.z() ? 0 : 2;
+        return extent.y() > extent.z() ? 1 : 2;
+    }
+
+    // Box that contains nothing; surrounding it with any box yields that box
+    static AABBT emptyBox()
+    {
+        return AABBT(Point(infinity, infinity, infinity), Point(-infinity, -infinity, -infinity));
+    }
+
+    bool hit(const RayT<Scalar> &ray, Interval rayInterval) const
+    {
+        Scalar intervalMin = static_cast<Scalar>(rayInterval.min());
+        Scalar intervalMax = static_cast<Scalar>(rayInterval.max());
 
         for (int axisIndex = 0; axisIndex < 3; ++axisIndex)
         {
-            double inverseDirection = 1.0 / ray.direction()[axisIndex];
-            double tNear = (min_[axisIndex] - ray.origin()[axisIndex]) * inverseDirection;
-            double tFar = (max_[axisIndex] - ray.origin()[axisIndex]) * inverseDirection;
-            if (inverseDirection < 0.0)
+            Scalar inverseDirection = Scalar(1) / ray.direction()[axisIndex];
+            Scalar tNear = (min_[axisIndex] - ray.origin()[axisIndex]) * inverseDirection;
+            Scalar tFar = (max_[axisIndex] - ray.origin()[axisIndex]) * inverseDirection;
+            if (inverseDirection < 0)
                 std::swap(tNear, tFar);
 
             intervalMin = std::max(tNear, intervalMin);
@@ -37,21 +65,30 @@ public:
     }
 
 private:
-    Point3 min_;
-    Point3 max_;
+    Point min_;
+    Point max_;
 };
 
-inline AABB surroundingBox(const AABB &box0, const AABB &box1)
+using AABB = AABBT<Real>;
+
+template <typename Scalar>
+inline AABBT<Scalar> surroundingBox(const AABBT<Scalar> &box0, const AABBT<Scalar> &box1)
 {
-    Point3 small(
+    Vector3T<Scalar> small(
         std::min(box0.min().x(), box1.min().x()),
         std::min(box0.min().y(), box1.min().y()),
         std::min(box0.min().z(), box1.min().z()));
-    Point3 large(
+    Vector3T<Scalar> large(
         std::max(box0.max().x(), box1.max().x()),
         std::max(box0.max().y(), box1.max().y()),
         std::max(box0.max().z(), box1.max().z()));
-    return AABB(small, large);
+    return AABBT<Scalar>(small, large);
+}
+
+template <typename Scalar>
+inline AABBT<Scalar> surroundingBox(const AABBT<Scalar> &box, const Vector3T<Scalar> &point)
+{
+    return surroundingBox(box, AABBT<Scalar>(point, point));
 }
 
-#endif // RAYTRACER_AABB_H
\ No newline at end of file
+#endif // RAYTRACER_AABB_H
@@ -0,0 +1,189 @@
+#ifndef RAYTRACER_AOV_H
+#define RAYTRACER_AOV_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Color3.h"
+#include "HitRecord.h"
+#include "ImageWriter.h"
+#include "Vector3.h"
+
+// Arbitrary output variables: auxiliary passes filled in by the same path-tracing pass as the image.
+// RendererParameters::aovPasses_ is a bitwise OR of these.
+enum AOVPass : uint32_t
+{
+    DepthPass = 1u << 0,      // Distance from the camera to the first hit
+    NormalPass = 1u << 1,     // First-hit shading normal
+    AlbedoPass = 1u << 2,     // First-hit base colour (the sky colour where the ray escapes)
+    MaterialIdPass = 1u << 3, // Material id of the first sample's first hit, -1 for the sky
+    DirectPass = 1u << 4,     // Emission seen directly plus light arriving straight from emitters at the first hit
+    IndirectPass = 1u << 5    // Everything else: the image minus the direct pass
+};
+
+// Pass named as in a scene file, or 0 if the name is unknown
+inline uint32_t aovPassNamed(std::string_view name)
+{
+    if (name == "depth")
+        return DepthPass;
+    if (name == "normal")
+        return NormalPass;
+    if (name == "albedo")
+        return AlbedoPass;
+    if (name == "material")
+        return MaterialIdPass;
+    if (name == "direct")
+        return DirectPass;
+    if (name == "indirect")
+        return IndirectPass;
+    return 0;
+}
+
+// Sums over a pixel's camera samples; rayColor adds to them at the first hit
+struct PixelAOVs
+{
+    static constexpr double missDepth = 1e30; // Far enough that no surface counts as the same depth as the sky
+    static constexpr int skyMaterialId = -1;
+
+    Color3 albedo_{0.0, 0.0, 0.0};
+    Vector3 normal_{0.0, 0.0, 0.0};
+    double depth_{0.0};
+    Color3 direct_{0.0, 0.0, 0.0};
+    int materialId_{skyMaterialId};
+    bool hasMaterialId_{false};
+
+    void addFirstHit(const Color3 &albedo, const Vector3 &normal, double depth, int materialId)
+    {
+        albedo_ += albedo;
+        normal_ += normal;
+        depth_ += depth;
+        if (!hasMaterialId_) // Ids cannot be averaged, so the first sample decides
+        {
+            materialId_ = materialId;
+            hasMaterialId_ = true;
+        }
+    }
+
+    void addDirect(const Color3 &direct) { direct_ += direct; }
+};
+
+// Per-pixel averages of the selected passes, one float plane per channel. Unselected planes stay empty.
+// The denoiser reads the albedo, normal and depth planes from here too.
+struct AOVBuffers
+{
+    uint32_t passes_{0};
+    int width_{0};
+    int height_{0};
+    std::array<std::vector<float>, 3> albedo_;
+    std::array<std::vector<float>, 3> normal_; // Averaged, so shorter than unit length on silhouettes
+    std::vector<float> depth_;
+    std::vector<float> materialId_;
+    std::array<std::vector<float>, 3> direct_;
+    std::array<std::vector<float>, 3> indirect_;
+
+    bool enabled() const { return passes_ != 0; }
+    bool has(AOVPass pass) const { return (passes_ & pass) != 0; }
+
+    void allocate(int width, int height, uint32_t passes)
+    {
+        passes_ = passes;
+        width_ = width;
+        height_ = height;
+        size_t pixels = static_cast<size_t>(width) * height;
+        for (int c = 0; c < 3; ++c)
+        {
+            allocatePlane(albedo_[c], AlbedoPass, pixels);
+            allocatePlane(normal_[c], NormalPass, pixels);
+            allocatePlane(direct_[c], DirectPass, pixels);
+            allocatePlane(indirect_[c], IndirectPass, pixels);
+        }
+        allocatePlane(depth_, DepthPass, pixels);
+        allocatePlane(materialId_, MaterialIdPass, pixels);
+    }
+
+    // Folds samples more samples into the pixel's averages, which already cover previousSamples (0 overwrites them).
+    // colorSum is the sum of those samples' colours, which the indirect pass is derived from.
+    void store(size_t pixel, const PixelAOVs &sums, int samples, int previousSamples, const Color3 &colorSum)
+    {
+        float total = static_cast<float>(samples + previousSamples);
+        float keep = static_cast<float>(previousSamples) / total; // Weight of the averages so far
+        float scale = 1.0f / total;
+        if (has(AlbedoPass))
+            blendColor(albedo_, pixel, sums.albedo_, keep, scale);
+        if (has(NormalPass))
+            blendColor(normal_, pixel, Color3(sums.normal_.x(), sums.normal_.y(), sums.normal_.z()), keep, scale);
+        if (has(DepthPass))
+            depth_[pixel] = depth_[pixel] * keep + static_cast<float>(sums.depth_) * scale;
+        if (has(MaterialIdPass) && previousSamples == 0)
+            materialId_[pixel] = static_cast<float>(sums.materialId_);
+        if (has(DirectPass))
+            blendColor(direct_, pixel, sums.direct_, keep, scale);
+        if (has(IndirectPass))
+            blendColor(indirect_, pixel, colorSum + sums.direct_ * -1.0, keep, scale);
+    }
+
+    // Every allocated plane in a fixed order, for copying whole pixels in and out (tile payloads, checkpoints)
+    std::vector<std::vector<float> *> planes()
+    {
+        std::vector<std::vector<float> *> allocated;
+        for (std::vector<float> *plane : {&albedo_[0], &albedo_[1], &albedo_[2], &normal_[0], &normal_[1], &normal_[2], &depth_,
+                                          &materialId_, &direct_[0], &direct_[1], &direct_[2], &indirect_[0], &indirect_[1], &indirect_[2]})
+        {
+            if (!plane->empty())
+                allocated.push_back(plane);
+        }
+        return allocated;
+    }
+
+    std::vector<const std::vector<float> *> planes() const
+    {
+        std::vector<std::vector<float> *> allocated = const_cast<AOVBuffers *>(this)->planes();
+        return {allocated.begin(), allocated.end()};
+    }
+
+    size_t planeCount() const { return planes().size(); }
+
+    // Adds the selected passes to a multi-layer image as <pass>.<channel>
+    void addLayers(LayeredImage &image) const
+    {
+        if (has(AlbedoPass))
+            addColorLayer(image, "albedo", albedo_, "RGB");
+        if (has(NormalPass))
+            addColorLayer(image, "normal", normal_, "XYZ");
+        if (has(DepthPass))
+            image.channels_.push_back({"depth.Z", depth_});
+        if (has(MaterialIdPass))
+            image.channels_.push_back({"material.id", materialId_});
+        if (has(DirectPass))
+            addColorLayer(image, "direct", direct_, "RGB");
+        if (has(IndirectPass))
+            addColorLayer(image, "indirect", indirect_, "RGB");
+    }
+
+private:
+    void allocatePlane(std::vector<float> &plane, AOVPass pass, size_t pixels)
+    {
+        if (has(pass))
+            plane.assign(pixels, 0.0f);
+        else
+            std::vector<float>().swap(plane);
+    }
+
+    static void blendColor(std::array<std::vector<float>, 3> &planes, size_t pixel, const Color3 &sum, float keep, float scale)
+    {
+        planes[0][pixel] = planes[0][pixel] * keep + static_cast<float>(sum.red()) * scale;
+        planes[1][pixel] = planes[1][pixel] * keep + static_cast<float>(sum.green()) * scale;
+        planes[2][pixel] = planes[2][pixel] * keep + static_cast<float>(sum.blue()) * scale;
+    }
+
+    static void addColorLayer(LayeredImage &image, const std::string &layer, const std::array<std::vector<float>, 3> &planes,
+                              const char *channelNames)
+    {
+        for (int c = 0; c < 3; ++c)
+            image.channels_.push_back({layer + "." + channelNames[c], planes[c]});
+    }
+};
+
+#endif // RAYTRACER_AOV_H
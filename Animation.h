@@ -0,0 +1,154 @@
+#ifndef RAYTRACER_ANIMATION_H
+#define RAYTRACER_ANIMATION_H
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include "Camera.h"
+#include "Instance.h"
+#include "Light.h"
+#include "Renderer.h"
+
+// Placement of an instance at one frame, kept as translate * rotate * scale so keys interpolate component-wise
+struct TransformKey
+{
+    double frame_{0.0};
+    Vector3 translation_{0, 0, 0};
+    Vector3 rotationAxis_{0, 1, 0};
+    double rotationDegrees_{0.0};
+    Vector3 scale_{1, 1, 1};
+
+    Transform transform() const
+    {
+        return Transform::translation(translation_) * Transform::rotation(rotationAxis_, rotationDegrees_) * Transform::scale(scale_);
+    }
+
+    static TransformKey blend(const TransformKey &a, const TransformKey &b, double t)
+    {
+        TransformKey key;
+        key.translation_ = a.translation_ * (1.0 - t) + b.translation_ * t;
+        key.rotationAxis_ = a.rotationAxis_ * (1.0 - t) + b.rotationAxis_ * t; // Keys of one track normally share an axis
+        key.rotationDegrees_ = a.rotationDegrees_ * (1.0 - t) + b.rotationDegrees_ * t;
+        key.scale_ = a.scale_ * (1.0 - t) + b.scale_ * t;
+        return key;
+    }
+};
+
+struct CameraKey
+{
+    double frame_{0.0};
+    Point3 position_{0, 0, 0};
+    Point3 imagePlaneCentre_{0, 0, -1};
+
+    static CameraKey blend(const CameraKey &a, const CameraKey &b, double t)
+    {
+        return {0.0, a.position_ * (1.0 - t) + b.position_ * t, a.imagePlaneCentre_ * (1.0 - t) + b.imagePlaneCentre_ * t};
+    }
+};
+
+// Linear between the keys around frame; the first and last keys hold outside their range. keys must be sorted by frame.
+template <typename Key>
+Key interpolateKeys(const std::vector<Key> &keys, double frame)
+{
+    auto next = std::upper_bound(keys.begin(), keys.end(), frame, [](double f, const Key &key)
+                                 { return f < key.frame_; });
+    if (next == keys.begin())
+        return keys.front();
+    if (next == keys.end())
+        return keys.back();
+    const Key &previous = *(next - 1);
+    return Key::blend(previous, *next, (frame - previous.frame_) / (next->frame_ - previous.frame_));
+}
+
+// Keyframed instance transforms and camera for frames [0, frameCount_)
+class Animation
+{
+public:
+    struct Track
+    {
+        size_t objectIndex_; // Index of an Instance in the object list the animation is applied to
+        std::vector<TransformKey> keys_;
+    };
+
+    int frameCount_{0};
+
+    bool empty() const { return frameCount_ <= 0; }
+    const std::vector<Track> &tracks() const { return tracks_; }
+
+    void addKey(size_t objectIndex, const TransformKey &key)
+    {
+        auto track = std::find_if(tracks_.begin(), tracks_.end(), [&](const Track &t)
+                                  { return t.objectIndex_ == objectIndex; });
+        if (track == tracks_.end())
+            track = tracks_.insert(tracks_.end(), Track{objectIndex, {}});
+        insertSorted(track->keys_, key);
+    }
+
+    void addCameraKey(const CameraKey &key) { insertSorted(cameraKeys_, key); }
+
+    // Moves every animated instance to where it is at frame
+    void apply(double frame, const std::vector<Object *> &objects) const
+    {
+        for (const Track &track : tracks_)
+        {
+            auto instance = dynamic_cast<Instance *>(objects.at(track.objectIndex_));
+            if (!instance)
+                throw std::invalid_argument("Animation: object " + std::to_string(track.objectIndex_) + " is not an instance");
+            instance->setTransform(interpolateKeys(track.keys_, frame).transform());
+        }
+    }
+
+    // The keyed camera at frame, or still when the camera has no keys
+    Camera camera(double frame, const Camera &still, const RendererParameters &params) const
+    {
+        if (cameraKeys_.empty())
+            return still;
+        CameraKey key = interpolateKeys(cameraKeys_, frame);
+        return Camera(key.position_, key.imagePlaneCentre_, params.imageHeight_,
+                      static_cast<double>(params.imageWidth_) / params.imageHeight_);
+    }
+
+private:
+    std::vector<Track> tracks_;
+    std::vector<CameraKey> cameraKeys_;
+
+    template <typename Key>
+    static void insertSorted(std::vector<Key> &keys, const Key &key)
+    {
+        auto position = std::upper_bound(keys.begin(), keys.end(), key.frame_, [](double f, const Key &k)
+                                         { return f < k.frame_; });
+        keys.insert(position, key);
+    }
+};
+
+// Renders every frame with one Renderer (threads and buffers are reused) over one top-level BVH, which is
+// built once and then refitted in place as the instances move. Lights are collected again every frame, since
+// emissive instances move with their keys. Files are numbered by frame.
+inline void renderAnimation(const Animation &animation, const std::vector<Object *> &objects, const MaterialTable &materials,
+                            const Camera &still, const RendererParameters &params,
+                            const BVHBuildParameters &buildParams = BVHBuildParameters::defaultParameters())
+{
+    animation.apply(0.0, objects);
+    TopLevelBVH world(objects, buildParams);
+    Renderer renderer(still, params);
+    for (int frame = 0; frame < animation.frameCount_; ++frame)
+    {
+        auto setupStart = std::chrono::steady_clock::now();
+        int rebuilt = 0;
+        if (frame > 0)
+        {
+            animation.apply(frame, objects);
+            rebuilt = world.refit();
+        }
+        LightSampler lights(objects, materials);
+        renderer.setFrame(animation.camera(frame, still, params), frame);
+        double setupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - setupStart).count();
+        std::cout << "Frame " << frame + 1 << "/" << animation.frameCount_ << ": set up in " << setupSeconds * 1e3 << " ms ("
+                  << (frame == 0 ? "BVH built" : "BVH refitted, " + std::to_string(rebuilt) + " subtree(s) rebuilt") << ")\n";
+        renderer.render(world, materials, lights);
+    }
+}
+
+#endif // RAYTRACER_ANIMATION_H
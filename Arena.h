@@ -0,0 +1,214 @@
+#ifndef RAYTRACER_ARENA_H
+#define RAYTRACER_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct ArenaStatistics
+{
+    size_t allocationCount_{0}; // Allocations since construction or the last reset()
+    size_t bytesUsed_{0};       // Bytes handed out, including alignment padding
+    size_t bytesReserved_{0};   // Bytes held in blocks
+    size_t blockCount_{0};
+};
+
+// Monotonic bump allocator. Objects are placed one after another in large blocks and are released
+// together: reset() or the destructor runs the destructors that are needed and gives back the blocks.
+// Not thread-safe; build scenes on one thread and share them read-only while rendering.
+class Arena
+{
+public:
+    static constexpr size_t defaultBlockSize = 64 * 1024;
+
+    explicit Arena(size_t blockSize = defaultBlockSize) : blockSize_{blockSize} {}
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    ~Arena()
+    {
+        runDestructors();
+    }
+
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        uintptr_t aligned = (current_ + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+        if (blocks_.empty() || aligned + size > limit_)
+        {
+            addBlock(size + alignment);
+            aligned = (current_ + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+        }
+        statistics_.bytesUsed_ += aligned + size - current_;
+        ++statistics_.allocationCount_;
+        current_ = aligned + size;
+        return reinterpret_cast<void *>(aligned);
+    }
+
+    // Constructs a T in the arena. Types with non-trivial destructors are remembered and destroyed
+    // in reverse order of creation when the arena is reset or destroyed.
+    template <typename T, typename... Args>
+    T *create(Args &&...args)
+    {
+        void *memory = allocate(sizeof(T), alignof(T));
+        T *object = new (memory) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>)
+        {
+            auto *record = static_cast<DestructorRecord *>(allocate(sizeof(DestructorRecord), alignof(DestructorRecord)));
+            *record = {[](void *p)
+                       { static_cast<T *>(p)->~T(); },
+                       object, destructors_};
+            destructors_ = record;
+        }
+        return object;
+    }
+
+    // Uninitialised array of a trivially destructible type
+    template <typename T>
+    T *allocateArray(size_t count)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "arena arrays are never destroyed");
+        return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // Destroys everything and rewinds. If the contents had spilled into several blocks they are
+    // merged into one block of the combined size, so repeating the same work allocates nothing new.
+    void reset()
+    {
+        runDestructors();
+        size_t reserved = statistics_.bytesReserved_;
+        if (blocks_.size() > 1)
+        {
+            blocks_.clear();
+            statistics_.bytesReserved_ = 0;
+            statistics_.blockCount_ = 0;
+            addBlock(reserved);
+        }
+        else if (!blocks_.empty())
+        {
+            current_ = reinterpret_cast<uintptr_t>(blocks_.back().memory_.get());
+        }
+        statistics_.allocationCount_ = 0;
+        statistics_.bytesUsed_ = 0;
+    }
+
+    const ArenaStatistics &statistics() const { return statistics_; }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> memory_;
+        size_t size_;
+    };
+
+    struct DestructorRecord
+    {
+        void (*destroy_)(void *);
+        void *object_;
+        DestructorRecord *next_;
+    };
+
+    size_t blockSize_;
+    std::vector<Block> blocks_;
+    uintptr_t current_{0};
+    uintptr_t limit_{0};
+    DestructorRecord *destructors_{nullptr};
+    ArenaStatistics statistics_;
+
+    void addBlock(size_t minimumSize)
+    {
+        size_t size = std::max(blockSize_, minimumSize);
+        blocks_.push_back({std::make_unique<std::byte[]>(size), size});
+        current_ = reinterpret_cast<uintptr_t>(blocks_.back().memory_.get());
+        limit_ = current_ + size;
+        statistics_.bytesReserved_ += size;
+        ++statistics_.blockCount_;
+    }
+
+    void runDestructors()
+    {
+        for (DestructorRecord *record = destructors_; record != nullptr; record = record->next_)
+            record->destroy_(record->object_);
+        destructors_ = nullptr;
+    }
+};
+
+// Fixed-size slots for one type, carved out of an arena. Destroyed objects go onto a free list
+// and their slots are handed out again, so churn (e.g. instances that come and go) does not grow the arena.
+template <typename T>
+class Pool
+{
+public:
+    explicit Pool(Arena &arena) : arena_{arena} {}
+
+    Pool(const Pool &) = delete;
+    Pool &operator=(const Pool &) = delete;
+
+    // Objects still alive are destroyed by the pool, not by the arena, so the pool must go first
+    ~Pool()
+    {
+        for (Slot *slot = allSlots_; slot != nullptr; slot = slot->allNext_)
+        {
+            if (slot->live_)
+                reinterpret_cast<T *>(slot->storage_)->~T();
+        }
+    }
+
+    template <typename... Args>
+    T *create(Args &&...args)
+    {
+        Slot *slot = freeList_;
+        if (slot != nullptr)
+        {
+            freeList_ = slot->next_;
+        }
+        else
+        {
+            slot = static_cast<Slot *>(arena_.allocate(sizeof(Slot), alignof(Slot)));
+            slot->allNext_ = allSlots_;
+            allSlots_ = slot;
+            ++capacity_;
+        }
+        T *object = new (slot->storage_) T(std::forward<Args>(args)...);
+        slot->live_ = true;
+        ++liveCount_;
+        return object;
+    }
+
+    void destroy(T *object)
+    {
+        if (object == nullptr)
+            return;
+        object->~T();
+        Slot *slot = reinterpret_cast<Slot *>(object); // The storage is the first member of the slot
+        slot->live_ = false;
+        slot->next_ = freeList_;
+        freeList_ = slot;
+        --liveCount_;
+    }
+
+    size_t liveCount() const { return liveCount_; }
+    size_t capacity() const { return capacity_; } // Slots ever taken from the arena
+
+private:
+    struct Slot
+    {
+        alignas(T) std::byte storage_[sizeof(T)];
+        Slot *next_;    // Free-list link
+        Slot *allNext_; // Link through every slot, live or free
+        bool live_;
+    };
+
+    Arena &arena_;
+    Slot *freeList_{nullptr};
+    Slot *allSlots_{nullptr};
+    size_t liveCount_{0};
+    size_t capacity_{0};
+};
+
+#endif // RAYTRACER_ARENA_H
@@ -0,0 +1,231 @@
+#ifndef RAYTRACER_BVH_CACHE_H
+#define RAYTRACER_BVH_CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "MappedFile.h"
+#include "WideBVH.h"
+
+// Binary cache of built BVHs and the flattened geometry they index. The file is a header, a table of
+// sections and the section data, each section 64-byte aligned, so BVH nodes can be used straight from
+// a read-only mapping. Sections carry no names: writer and reader agree on their order.
+struct BVHCacheHeader
+{
+    static constexpr char expectedMagic[8] = {'R', 'T', 'B', 'V', 'H', 'C', '\r', '\n'};
+    static constexpr uint32_t currentVersion = 1;
+
+    char magic_[8];
+    uint32_t version_;
+    uint32_t nodeWidth_; // WideBVH width the nodes were built for
+    uint32_t nodeSize_;  // sizeof(WideBVHNode<nodeWidth_>), which also catches layout and endianness changes
+    uint32_t sectionCount_;
+};
+
+struct BVHCacheSection
+{
+    uint64_t offset_;
+    uint64_t size_; // In bytes
+};
+
+class BVHCacheWriter
+{
+public:
+    template <typename T>
+    void add(std::span<const T> data)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "cache sections hold plain data only");
+        const char *bytes = reinterpret_cast<const char *>(data.data());
+        sections_.emplace_back(bytes, bytes + data.size_bytes());
+    }
+
+    // Nodes, primitive order (as indices into objects, the list the BVH was built from) and bounding box
+    template <int Width>
+    void addBVH(const WideBVH<Width> &bvh, const std::vector<const Object *> &objects)
+    {
+        std::unordered_map<const Object *, uint32_t> indexOf;
+        indexOf.reserve(objects.size());
+        for (size_t i = 0; i < objects.size(); ++i)
+            indexOf.emplace(objects[i], static_cast<uint32_t>(i));
+
+        std::vector<uint32_t> order;
+        order.reserve(bvh.primitives().size());
+        for (const Object *primitive : bvh.primitives())
+            order.push_back(indexOf.at(primitive));
+
+        AABB box = bvh.boundingBox();
+        double bounds[6] = {box.min().x(), box.min().y(), box.min().z(), box.max().x(), box.max().y(), box.max().z()};
+        add(bvh.nodes());
+        add(std::span<const uint32_t>(order));
+        add(std::span<const double>(bounds));
+    }
+
+    // Written to a temporary file first and renamed, so readers never see a half-written cache
+    template <int Width>
+    void write(const std::string &path) const
+    {
+        BVHCacheHeader header{};
+        std::memcpy(header.magic_, BVHCacheHeader::expectedMagic, sizeof(header.magic_));
+        header.version_ = BVHCacheHeader::currentVersion;
+        header.nodeWidth_ = Width;
+        header.nodeSize_ = sizeof(WideBVHNode<Width>);
+        header.sectionCount_ = static_cast<uint32_t>(sections_.size());
+
+        std::vector<BVHCacheSection> table(sections_.size());
+        uint64_t offset = alignUp(sizeof(header) + table.size() * sizeof(BVHCacheSection));
+        for (size_t i = 0; i < sections_.size(); ++i)
+        {
+            table[i] = {offset, sections_[i].size()};
+            offset = alignUp(offset + sections_[i].size());
+        }
+
+        std::string temporaryPath = path + ".tmp";
+        {
+            std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+                throw std::runtime_error("cannot open " + temporaryPath + " for writing");
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char *>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(BVHCacheSection)));
+            uint64_t written = sizeof(header) + table.size() * sizeof(BVHCacheSection);
+            const char padding[sectionAlignment] = {};
+            for (size_t i = 0; i < sections_.size(); ++i)
+            {
+                out.write(padding, static_cast<std::streamsize>(table[i].offset_ - written));
+                out.write(sections_[i].data(), static_cast<std::streamsize>(sections_[i].size()));
+                written = table[i].offset_ + sections_[i].size();
+            }
+            if (!out)
+                throw std::runtime_error("failed writing " + temporaryPath);
+        }
+        std::filesystem::rename(temporaryPath, path);
+    }
+
+    static constexpr uint64_t sectionAlignment = 64;
+
+private:
+    std::vector<std::vector<char>> sections_;
+
+    static uint64_t alignUp(uint64_t value) { return (value + sectionAlignment - 1) & ~(sectionAlignment - 1); }
+};
+
+// Read side: maps the file and hands out typed views of its sections. Views and BVHs built from them
+// point into the mapping, so the BVHCache must outlive them.
+class BVHCache
+{
+public:
+    // Throws if the file is not a cache written for WideBVH<Width> by this version
+    template <int Width>
+    static std::unique_ptr<BVHCache> open(const std::string &path)
+    {
+        auto cache = std::unique_ptr<BVHCache>(new BVHCache(path));
+        const BVHCacheHeader &header = cache->header_;
+        if (header.nodeWidth_ != Width || header.nodeSize_ != sizeof(WideBVHNode<Width>))
+            throw std::runtime_error(path + ": built for a different BVH node layout");
+        return cache;
+    }
+
+    // True if the cache exists and was written after every input was last modified
+    static bool isNewerThan(const std::string &cachePath, const std::vector<std::string> &inputs)
+    {
+        std::error_code error;
+        auto cacheTime = std::filesystem::last_write_time(cachePath, error);
+        if (error)
+            return false;
+        for (const std::string &input : inputs)
+        {
+            auto inputTime = std::filesystem::last_write_time(input, error);
+            if (error || inputTime > cacheTime)
+                return false;
+        }
+        return true;
+    }
+
+    size_t sectionCount() const { return sections_.size(); }
+
+    template <typename T>
+    std::span<const T> section(size_t index) const
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "cache sections hold plain data only");
+        if (index >= sections_.size())
+            throw std::runtime_error("BVH cache: missing section " + std::to_string(index));
+        const BVHCacheSection &entry = sections_[index];
+        if (entry.size_ % sizeof(T) != 0)
+            throw std::runtime_error("BVH cache: section " + std::to_string(index) + " has the wrong element size");
+        return std::span<const T>(reinterpret_cast<const T *>(file_.data() + entry.offset_), entry.size_ / sizeof(T));
+    }
+
+    // Reads the three sections written by BVHCacheWriter::addBVH, starting at index, and advances index past them.
+    // objects must be the list the BVH was originally built from, in the same order.
+    template <int Width>
+    std::unique_ptr<WideBVH<Width>> readBVH(size_t &index, const std::vector<Object *> &objects) const
+    {
+        std::span<const WideBVHNode<Width>> nodes = section<WideBVHNode<Width>>(index);
+        std::span<const uint32_t> order = section<uint32_t>(index + 1);
+        std::span<const double> bounds = section<double>(index + 2);
+        index += 3;
+        if (nodes.empty() || bounds.size() != 6 || order.size() != objects.size())
+            throw std::runtime_error("BVH cache: BVH does not match the scene");
+
+        // Every child index is checked once here so traversal can trust the nodes
+        for (const WideBVHNode<Width> &node : nodes)
+        {
+            for (int slot = 0; slot < Width; ++slot)
+            {
+                uint32_t child = node.child_[slot];
+                bool valid = (child == WideBVH<Width>::emptySlot) ||
+                             (node.primitiveCount_[slot] == 0 ? child < nodes.size()
+                                                              : uint64_t(child) + node.primitiveCount_[slot] <= order.size());
+                if (!valid)
+                    throw std::runtime_error("BVH cache: node refers past the end of the BVH");
+            }
+        }
+
+        std::vector<const Object *> primitives;
+        primitives.reserve(order.size());
+        for (uint32_t objectIndex : order)
+        {
+            if (objectIndex >= objects.size())
+                throw std::runtime_error("BVH cache: primitive index out of range");
+            primitives.push_back(objects[objectIndex]);
+        }
+        AABB box(Point3(bounds[0], bounds[1], bounds[2]), Point3(bounds[3], bounds[4], bounds[5]));
+        return std::make_unique<WideBVH<Width>>(nodes, std::move(primitives), box);
+    }
+
+private:
+    MappedFile file_;
+    BVHCacheHeader header_{};
+    std::vector<BVHCacheSection> sections_;
+
+    explicit BVHCache(const std::string &path) : file_{path}
+    {
+        if (file_.size() < sizeof(BVHCacheHeader))
+            throw std::runtime_error(path + ": too short for a BVH cache");
+        std::memcpy(&header_, file_.data(), sizeof(header_));
+        if (std::memcmp(header_.magic_, BVHCacheHeader::expectedMagic, sizeof(header_.magic_)) != 0 ||
+            header_.version_ != BVHCacheHeader::currentVersion)
+            throw std::runtime_error(path + ": not a BVH cache of this version");
+
+        size_t tableEnd = sizeof(header_) + static_cast<size_t>(header_.sectionCount_) * sizeof(BVHCacheSection);
+        if (tableEnd > file_.size())
+            throw std::runtime_error(path + ": truncated section table");
+        sections_.resize(header_.sectionCount_);
+        std::memcpy(sections_.data(), file_.data() + sizeof(header_), sections_.size() * sizeof(BVHCacheSection));
+        for (const BVHCacheSection &entry : sections_)
+        {
+            if (entry.offset_ % BVHCacheWriter::sectionAlignment != 0 || entry.offset_ > file_.size() ||
+                entry.size_ > file_.size() - entry.offset_)
+                throw std::runtime_error(path + ": section outside the file");
+        }
+    }
+};
+
+#endif // RAYTRACER_BVH_CACHE_H
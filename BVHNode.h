@@ -3,74 +3,274 @@
 
 #include <vector>
 #include <algorithm>
+#include <memory>
+#include <span>
+#include "Arena.h"
 #include "Scene.h"
 
+class BVHBuildParameters
+{
+public:
+    int maximumLeafSize_{4};     // Ranges at or below this size may become leaves
+    int binCount_{16};           // Number of centroid bins evaluated per axis
+    int maximumSahDepth_{32};    // Deeper ranges are split at the median to bound the tree depth
+    double traversalCost_{1.0};  // Relative cost of visiting an interior node
+    double intersectionCost_{1.0}; // Relative cost of one primitive test
+    double refitRebuildThreshold_{1.5}; // Refit: subtrees whose SAH cost grew past this factor of their built cost are rebuilt
+    static BVHBuildParameters defaultParameters()
+    {
+        return BVHBuildParameters();
+    }
+};
+
+// Per-primitive data computed once before the build
+struct BVHPrimitive
+{
+    AABB box_;
+    Point3 centroid_;
+    Object *object_;
+};
+
 class BVHNode : public Object
 {
 public:
-    BVHNode(std::vector<Object *> &objects, size_t start, size_t end)
+    // Builds over objects[start, end). Child nodes and leaf lists are placed in a private arena owned by this root.
+    BVHNode(std::vector<Object *> &objects, size_t start, size_t end,
+            const BVHBuildParameters &params = BVHBuildParameters::defaultParameters())
+        : ownedArena_{std::make_unique<Arena>()}
+    {
+        buildRoot(objects, start, end, params, *ownedArena_);
+    }
+
+    // Same, with the children placed in a caller-owned arena (for example the scene's), which must outlive the tree
+    BVHNode(std::vector<Object *> &objects, size_t start, size_t end, Arena &arena,
+            const BVHBuildParameters &params = BVHBuildParameters::defaultParameters())
+    {
+        buildRoot(objects, start, end, params, arena);
+    }
+
+    BVHNode(std::vector<BVHPrimitive> &primitives, size_t start, size_t end, const BVHBuildParameters &params, int depth, Arena &arena)
+    {
+        build(primitives, start, end, params, depth, arena);
+    }
+
+    // Children live in an arena and are released with it, never one by one
+    BVHNode(const BVHNode &) = delete;
+    BVHNode &operator=(const BVHNode &) = delete;
+
+    bool intersect(const Ray &ray, Interval rayInterval, PrimitiveHit &hit) const override
     {
-        int axis = randomInt(0, 2); // Randomly choose an axis (0, 1, or 2)
-        auto comparator = [axis](Object *objectA, Object *objectB)
+        RAYTRACER_COUNT(nodesVisited_, 1);
+        if (!box_.hit(ray, rayInterval))
+            return false; // If the ray does not hit the bounding box, return no hit
+
+        if (isLeaf())
         {
-            return objectA->boundingBox().min()[axis] < objectB->boundingBox().min()[axis];
-        };
+            bool hitAnything = false;
+            double closestSoFar = rayInterval.max();
+            for (const Object *primitive : primitives_)
+            {
+                RAYTRACER_COUNT(primitiveTests_, 1);
+                if (primitive->intersect(ray, Interval(rayInterval.min(), closestSoFar), hit))
+                {
+                    hitAnything = true;
+                    closestSoFar = hit.distance_;
+                }
+            }
+            return hitAnything;
+        }
 
-        size_t objectSpan = end - start;
-        if (objectSpan == 1)
+        bool leftHit = left_->intersect(ray, rayInterval, hit);
+        double closestSoFar = leftHit ? hit.distance_ : rayInterval.max();
+        bool rightHit = right_->intersect(ray, Interval(rayInterval.min(), closestSoFar), hit); // Only closer hits can win
+        return leftHit || rightHit;
+    };
+
+    bool occluded(const Ray &ray, Interval rayInterval) const override
+    {
+        RAYTRACER_COUNT(nodesVisited_, 1);
+        if (!box_.hit(ray, rayInterval))
+            return false;
+
+        if (isLeaf())
         {
-            left_ = right_ = objects[start];
+            for (const Object *primitive : primitives_)
+            {
+                RAYTRACER_COUNT(primitiveTests_, 1);
+                if (primitive->occluded(ray, rayInterval))
+                    return true;
+            }
+            return false;
         }
-        else if (objectSpan == 2)
+        return left_->occluded(ray, rayInterval) || right_->occluded(ray, rayInterval);
+    }
+
+    AABB boundingBox() const override
+    {
+        return box_;
+    };
+
+    bool isLeaf() const { return left_ == nullptr; }
+    const BVHNode *left() const { return left_; }
+    const BVHNode *right() const { return right_; }
+    std::span<Object *const> primitives() const { return primitives_; }
+    int splitAxis() const { return splitAxis_; }
+
+    // Expected cost of a random ray hitting the root, relative to one primitive test
+    double sahCost(const BVHBuildParameters &params = BVHBuildParameters::defaultParameters()) const
+    {
+        double rootArea = box_.surfaceArea();
+        return rootArea > 0.0 ? subtreeCost(params) / rootArea : 0.0;
+    }
+
+private:
+    BVHNode *left_{nullptr};
+    BVHNode *right_{nullptr};
+    std::span<Object *> primitives_; // Only filled for leaves
+    std::unique_ptr<Arena> ownedArena_; // Only set on roots that own their nodes
+    AABB box_;
+    int splitAxis_{0};
+
+    struct Bin
+    {
+        AABB box_{AABB::emptyBox()};
+        size_t count_{0};
+    };
+
+    void buildRoot(std::vector<Object *> &objects, size_t start, size_t end, const BVHBuildParameters &params, Arena &arena)
+    {
+        std::vector<BVHPrimitive> primitives;
+        primitives.reserve(end - start);
+        for (size_t i = start; i < end; ++i)
         {
-            if (comparator(objects[start], objects[start + 1]))
+            AABB box = objects[i]->boundingBox();
+            primitives.push_back({box, box.centroid(), objects[i]});
+        }
+        build(primitives, 0, primitives.size(), params, 0, arena);
+
+        // Leave the caller's range in leaf order, as the previous sort-based build did
+        for (size_t i = start; i < end; ++i)
+            objects[i] = primitives[i - start].object_;
+    }
+
+    void build(std::vector<BVHPrimitive> &primitives, size_t start, size_t end, const BVHBuildParameters &params, int depth, Arena &arena)
+    {
+        box_ = AABB::emptyBox();
+        AABB centroidBox = AABB::emptyBox();
+        for (size_t i = start; i < end; ++i)
+        {
+            box_ = surroundingBox(box_, primitives[i].box_);
+            centroidBox = surroundingBox(centroidBox, primitives[i].centroid_);
+        }
+
+        size_t objectSpan = end - start;
+        double leafCost = params.intersectionCost_ * objectSpan;
+        bool mayBeLeaf = objectSpan <= static_cast<size_t>(std::max(params.maximumLeafSize_, 1));
+
+        int bestAxis = -1;
+        int bestSplit = 0;
+        double bestCost = infinity;
+        int binCount = std::max(params.binCount_, 2);
+        double parentArea = box_.surfaceArea();
+
+        bool useSah = depth < params.maximumSahDepth_;
+        for (int axis = 0; axis < 3 && objectSpan > 1 && useSah; ++axis)
+        {
+            double axisMin = centroidBox.min()[axis];
+            double axisExtent = centroidBox.max()[axis] - axisMin;
+            if (axisExtent <= 0.0)
+                continue; // All centroids coincide along this axis
+
+            std::vector<Bin> bins(binCount);
+            for (size_t i = start; i < end; ++i)
+            {
+                int b = binIndex(primitives[i].centroid_[axis], axisMin, axisExtent, binCount);
+                bins[b].box_ = surroundingBox(bins[b].box_, primitives[i].box_);
+                bins[b].count_++;
+            }
+
+            // Sweep from the right to get the area and count of every right-hand side
+            std::vector<double> rightArea(binCount, 0.0);
+            std::vector<size_t> rightCount(binCount, 0);
+            AABB accumulated = AABB::emptyBox();
+            size_t count = 0;
+            for (int b = binCount - 1; b > 0; --b)
             {
-                left_ = objects[start];
-                right_ = objects[start + 1];
+                accumulated = surroundingBox(accumulated, bins[b].box_);
+                count += bins[b].count_;
+                rightArea[b] = accumulated.surfaceArea();
+                rightCount[b] = count;
             }
-            else
+
+            accumulated = AABB::emptyBox();
+            count = 0;
+            for (int split = 1; split < binCount; ++split)
             {
-                left_ = objects[start + 1];
-                right_ = objects[start];
+                accumulated = surroundingBox(accumulated, bins[split - 1].box_);
+                count += bins[split - 1].count_;
+                if (count == 0 || rightCount[split] == 0)
+                    continue;
+
+                double cost = params.traversalCost_ +
+                              params.intersectionCost_ * (accumulated.surfaceArea() * count + rightArea[split] * rightCount[split]) / parentArea;
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
             }
         }
-        else
+
+        if (mayBeLeaf && (!useSah || bestAxis < 0 || leafCost <= bestCost))
         {
-            std::sort(objects.begin() + start, objects.begin() + end, comparator);
-            size_t mid = start + objectSpan / 2;
-            left_ = new BVHNode(objects, start, mid);
-            right_ = new BVHNode(objects, mid, end);
+            primitives_ = std::span<Object *>(arena.allocateArray<Object *>(objectSpan), objectSpan);
+            for (size_t i = start; i < end; ++i)
+                primitives_[i - start] = primitives[i].object_;
+            return;
         }
-        box_ = surroundingBox(left_->boundingBox(), right_->boundingBox());
-    };
-    std::optional<HitRecord> rayHit(const Ray &ray, Interval rayInterval) const override
-    {
-        if (!box_.hit(ray, rayInterval))
-            return std::nullopt; // If the ray does not hit the bounding box, return no hit
 
-        auto leftHit = left_->rayHit(ray, rayInterval);
-        auto rightHit = right_->rayHit(ray, rayInterval);
-        if (leftHit && rightHit)
+        size_t mid;
+        if (bestAxis >= 0)
         {
-            return (leftHit->distanceAlongRay() < rightHit->distanceAlongRay()) ? leftHit : rightHit;
+            double axisMin = centroidBox.min()[bestAxis];
+            double axisExtent = centroidBox.max()[bestAxis] - axisMin;
+            auto middle = std::partition(primitives.begin() + start, primitives.begin() + end,
+                                         [&](const BVHPrimitive &primitive)
+                                         {
+                                             return binIndex(primitive.centroid_[bestAxis], axisMin, axisExtent, binCount) < bestSplit;
+                                         });
+            mid = middle - primitives.begin();
+            splitAxis_ = bestAxis;
         }
-        else if (leftHit)
+        else
         {
-            return leftHit;
+            // Too deep for SAH, or every centroid is identical: split by count along the widest axis
+            mid = start + objectSpan / 2;
+            splitAxis_ = centroidBox.longestAxis();
+            int axis = splitAxis_;
+            std::nth_element(primitives.begin() + start, primitives.begin() + mid, primitives.begin() + end,
+                             [axis](const BVHPrimitive &a, const BVHPrimitive &b)
+                             { return a.centroid_[axis] < b.centroid_[axis]; });
         }
-        else
-            return rightHit;
-    };
 
-    AABB boundingBox() const override
+        left_ = arena.create<BVHNode>(primitives, start, mid, params, depth + 1, arena);
+        right_ = arena.create<BVHNode>(primitives, mid, end, params, depth + 1, arena);
+    }
+
+    static int binIndex(double value, double axisMin, double axisExtent, int binCount)
     {
-        return box_;
-    };
+        int b = static_cast<int>(binCount * ((value - axisMin) / axisExtent));
+        return std::clamp(b, 0, binCount - 1);
+    }
 
-private:
-    Object *left_;
-    Object *right_;
-    AABB box_;
+    double subtreeCost(const BVHBuildParameters &params) const
+    {
+        double area = box_.surfaceArea();
+        if (isLeaf())
+            return params.intersectionCost_ * primitives_.size() * area;
+        return params.traversalCost_ * area + left_->subtreeCost(params) + right_->subtreeCost(params);
+    }
 };
 
-#endif // BVHNODE_H
\ No newline at end of file
+#endif // BVHNODE_H
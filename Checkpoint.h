@@ -0,0 +1,173 @@
+#ifndef RAYTRACER_CHECKPOINT_H
+#define RAYTRACER_CHECKPOINT_H
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "AOV.h"
+#include "Color3.h"
+
+// Accumulation state of a progressive render. Every sample's random numbers follow from the seed, the pixel and
+// the sample index (Sampler::startPixelSample), so the seed and the next sample index are all the RNG state there is.
+struct CheckpointHeader
+{
+    static constexpr char expectedMagic[8] = {'R', 'T', 'C', 'K', 'P', 'T', '\r', '\n'};
+    static constexpr uint32_t currentVersion = 1;
+
+    char magic_[8];
+    uint32_t version_;
+    uint32_t width_;
+    uint32_t height_;
+    uint32_t samplesPerPixel_; // The render's target
+    uint32_t samplerType_;
+    uint32_t aovPasses_;
+    uint32_t passIndex_;  // Passes finished
+    uint32_t nextSample_; // Sample index the next pass starts at; every pixel's sums hold the samples below it
+    uint64_t randomSeed_;
+    uint32_t mergedRuns_; // 1 for a render's own checkpoint; merged ones cannot be resumed
+    uint32_t reserved_;
+};
+
+// Colour sums (not averages) and sample counts per pixel, plus the AOV averages, on disk as the header followed
+// by the sums as doubles, the counts and one float plane per allocated AOV channel
+class RenderCheckpoint
+{
+public:
+    CheckpointHeader header_{};
+    std::vector<double> sums_; // R, G, B per pixel
+    std::vector<int> counts_;
+    AOVBuffers aovs_;
+
+    // Written to a temporary file first and renamed, so a run stopped mid-write keeps the previous checkpoint
+    static void write(const std::string &path, const CheckpointHeader &header, std::span<const Color3> sums, std::span<const int> counts,
+                      const AOVBuffers &aovs)
+    {
+        std::vector<double> doubleSums(sums.size() * 3);
+        for (size_t p = 0; p < sums.size(); ++p)
+        {
+            doubleSums[3 * p] = sums[p].red();
+            doubleSums[3 * p + 1] = sums[p].green();
+            doubleSums[3 * p + 2] = sums[p].blue();
+        }
+        write(path, header, std::span<const double>(doubleSums), counts, aovs);
+    }
+
+    // Saves a loaded (for example merged) checkpoint
+    void write(const std::string &path) const
+    {
+        write(path, header_, std::span<const double>(sums_), counts_, aovs_);
+    }
+
+    // Throws if the file is not a complete checkpoint of this version
+    static RenderCheckpoint read(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            throw std::runtime_error("cannot open " + path);
+        RenderCheckpoint checkpoint;
+        CheckpointHeader &header = checkpoint.header_;
+        in.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (!in || std::memcmp(header.magic_, CheckpointHeader::expectedMagic, sizeof(header.magic_)) != 0 ||
+            header.version_ != CheckpointHeader::currentVersion)
+            throw std::runtime_error(path + ": not a render checkpoint of this version");
+
+        size_t pixels = static_cast<size_t>(header.width_) * header.height_;
+        checkpoint.sums_.resize(pixels * 3);
+        checkpoint.counts_.resize(pixels);
+        checkpoint.aovs_.allocate(static_cast<int>(header.width_), static_cast<int>(header.height_), header.aovPasses_);
+        readSpan(in, std::span<double>(checkpoint.sums_));
+        readSpan(in, std::span<int>(checkpoint.counts_));
+        for (std::vector<float> *plane : checkpoint.aovs_.planes())
+            readSpan(in, std::span<float>(*plane));
+        if (!in)
+            throw std::runtime_error(path + ": truncated checkpoint");
+        return checkpoint;
+    }
+
+    // Adds the samples of another run of the same frame. Its seed must differ, or it would add the same samples again.
+    void merge(const RenderCheckpoint &other)
+    {
+        if (other.header_.width_ != header_.width_ || other.header_.height_ != header_.height_ ||
+            other.header_.aovPasses_ != header_.aovPasses_ || other.header_.samplerType_ != header_.samplerType_)
+            throw std::runtime_error("RenderCheckpoint::merge: checkpoints differ in image size, AOV passes or sampler");
+        if (other.header_.randomSeed_ == header_.randomSeed_)
+            throw std::runtime_error("RenderCheckpoint::merge: both runs used seed " + std::to_string(header_.randomSeed_) +
+                                     ", so they traced the same samples");
+
+        std::vector<const std::vector<float> *> otherPlanes = other.aovs_.planes();
+        std::vector<std::vector<float> *> planes = aovs_.planes();
+        for (size_t p = 0; p < counts_.size(); ++p)
+        {
+            int total = counts_[p] + other.counts_[p];
+            if (total > 0)
+            {
+                float keep = static_cast<float>(counts_[p]) / total;
+                for (size_t c = 0; c < planes.size(); ++c)
+                {
+                    if (planes[c] == &aovs_.materialId_) // Ids cannot be averaged; the first run's stays
+                        continue;
+                    (*planes[c])[p] = (*planes[c])[p] * keep + (*otherPlanes[c])[p] * (1.0f - keep);
+                }
+            }
+            for (int c = 0; c < 3; ++c)
+                sums_[3 * p + c] += other.sums_[3 * p + c];
+            counts_[p] = total;
+        }
+        header_.samplesPerPixel_ += other.header_.samplesPerPixel_;
+        header_.mergedRuns_ += other.header_.mergedRuns_;
+    }
+
+    // Average radiance per pixel as R, G, B; pixels without samples are black
+    std::vector<float> averagePixels() const
+    {
+        std::vector<float> pixels(sums_.size());
+        for (size_t p = 0; p < counts_.size(); ++p)
+        {
+            double scale = counts_[p] > 0 ? 1.0 / counts_[p] : 0.0;
+            for (int c = 0; c < 3; ++c)
+                pixels[3 * p + c] = static_cast<float>(sums_[3 * p + c] * scale);
+        }
+        return pixels;
+    }
+
+private:
+    static void write(const std::string &path, CheckpointHeader header, std::span<const double> sums, std::span<const int> counts,
+                      const AOVBuffers &aovs)
+    {
+        std::memcpy(header.magic_, CheckpointHeader::expectedMagic, sizeof(header.magic_));
+        header.version_ = CheckpointHeader::currentVersion;
+        std::string temporaryPath = path + ".tmp";
+        {
+            std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+                throw std::runtime_error("cannot open " + temporaryPath + " for writing");
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            writeSpan(out, sums);
+            writeSpan(out, counts);
+            for (const std::vector<float> *plane : aovs.planes())
+                writeSpan(out, std::span<const float>(*plane));
+            if (!out)
+                throw std::runtime_error("failed writing " + temporaryPath);
+        }
+        std::filesystem::rename(temporaryPath, path);
+    }
+
+    template <typename T>
+    static void writeSpan(std::ofstream &out, std::span<const T> values)
+    {
+        out.write(reinterpret_cast<const char *>(values.data()), static_cast<std::streamsize>(values.size_bytes()));
+    }
+
+    template <typename T>
+    static void readSpan(std::ifstream &in, std::span<T> values)
+    {
+        in.read(reinterpret_cast<char *>(values.data()), static_cast<std::streamsize>(values.size_bytes()));
+    }
+};
+
+#endif // RAYTRACER_CHECKPOINT_H
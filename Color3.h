@@ -4,22 +4,34 @@
 #include "HelperFunctions.h"
 #include "Vector3.h"
 
-class Color3
+template <typename Scalar>
+class Color3T
 {
 public:
-    Color3() = default;
-    Color3(double x, double y, double z) : colorVec_{x, y, z} {};
+    Color3T() = default;
+    Color3T(double x, double y, double z) : colorVec_{x, y, z} {};
 
     int r() const { return int(255.999 * colorVec_.x()); }
     int g() const { return int(255.999 * colorVec_.y()); }
     int b() const { return int(255.999 * colorVec_.z()); }
 
-    Color3 operator*(double scale) const
+    Scalar red() const { return colorVec_.x(); }
+    Scalar green() const { return colorVec_.y(); }
+    Scalar blue() const { return colorVec_.z(); }
+
+    // Rec. 709 relative luminance
+    Scalar luminance() const
     {
-        return {scale * colorVec_.x(), scale * colorVec_.y(), scale * colorVec_.z()};
+        return Scalar(0.2126) * colorVec_.x() + Scalar(0.7152) * colorVec_.y() + Scalar(0.0722) * colorVec_.z();
     }
 
-    Color3 operator*(const Color3 &other) const
+    Color3T operator*(double scale) const
+    {
+        Scalar s = static_cast<Scalar>(scale);
+        return {s * colorVec_.x(), s * colorVec_.y(), s * colorVec_.z()};
+    }
+
+    Color3T operator*(const Color3T &other) const
     {
         return {
             (colorVec_.x() * other.colorVec_.x()),
@@ -27,19 +39,19 @@ public:
             (colorVec_.z() * other.colorVec_.z())};
     }
 
-    friend Color3 operator*(double scale, Color3 &vector)
+    friend Color3T operator*(double scale, const Color3T &vector)
     {
         return vector * scale;
     }
 
-    Color3 operator+(const Color3 other) const
+    Color3T operator+(const Color3T other) const
     {
         return {(colorVec_.x() + other.colorVec_.x()),
                 (colorVec_.y() + other.colorVec_.y()),
                 (colorVec_.z() + other.colorVec_.z())};
     }
 
-    Color3 operator+=(const Color3 &other)
+    Color3T operator+=(const Color3T &other)
     {
         colorVec_[0] += other.colorVec_[0];
         colorVec_[1] += other.colorVec_[1];
@@ -47,7 +59,7 @@ public:
         return *this;
     }
 
-    Color3 correctedAverage(int samplesPerPixel)
+    Color3T correctedAverage(int samplesPerPixel)
     {
         double scale = 1.0 / samplesPerPixel;
         return {
@@ -56,16 +68,16 @@ public:
             sqrt(scale * colorVec_.z())};
     }
 
-    Color3 &operator/=(double scale)
+    Color3T &operator/=(double scale)
     {
-        colorVec_[0] /= scale;
-        colorVec_[1] /= scale;
-        colorVec_[2] /= scale;
+        colorVec_ /= static_cast<Scalar>(scale);
         return *this;
     }
 
 private:
-    Vector3 colorVec_{0.0, 0.0, 0.0};
+    Vector3T<Scalar> colorVec_{0.0, 0.0, 0.0};
 };
 
+using Color3 = Color3T<Real>;
+
 #endif // RAYTRACER_COLOR3_H
@@ -0,0 +1,178 @@
+#ifndef RAYTRACER_DENOISER_H
+#define RAYTRACER_DENOISER_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+#include "AOV.h"
+#include "Color3.h"
+#include "ThreadPool.h"
+#include "Tile.h"
+
+class DenoiserParameters
+{
+public:
+    int iterations_{5};        // Pass i spreads the 5x5 kernel over 2^i-pixel steps: 5 passes reach 62 pixels out
+    double colorSigma_{0.5};   // Illumination difference that costs a neighbour most of its weight; halved every pass
+    double normalSigma_{0.1};  // Same for 1 - cos of the angle between first-hit normals
+    double depthSigma_{0.05};  // Same for depth difference, relative to depth and per pixel of step
+    double albedoSigma_{0.1};  // Same for first-hit albedo difference
+    static DenoiserParameters defaultParameters()
+    {
+        return DenoiserParameters();
+    }
+};
+
+// (1 + x/16)^-16 for x >= 0: within 3% of exp(-x) up to x = 1 and falling towards zero after it.
+// Weights only need a smooth, fast falloff, and unlike std::exp this has no branches or calls, so it vectorises.
+inline float exponentialDecay(float x)
+{
+    float base = 1.0f + x * (1.0f / 16.0f);
+    base *= base;
+    base *= base;
+    base *= base;
+    base *= base;
+    return 1.0f / base; // Huge x overflows base to infinity, which gives zero
+}
+
+// Edge-avoiding à-trous wavelet filter (Dammertz et al. 2010). Radiance is divided by the first-hit albedo,
+// so texture is not blurred, then filtered with a 5x5 B3-spline kernel whose taps are spread further apart
+// every pass; each tap is weighted down by its difference in illumination, normal, depth and albedo.
+class Denoiser
+{
+public:
+    explicit Denoiser(const DenoiserParameters &params) : params_(params) {}
+
+    // Replaces image (linear radiance, width_ x height_ of features) with its filtered version.
+    // features must hold the albedo, normal and depth passes.
+    // Every pass is split across the pool by tile; passes are separated by the pool's join.
+    void denoise(std::vector<Color3> &image, const AOVBuffers &features, const std::vector<Tile> &tiles, ThreadPool &pool)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            illumination_[c].resize(image.size());
+            filtered_[c].resize(image.size());
+        }
+
+        pool.run(tiles.size(), [&](size_t tileIndex, int)
+                 { demodulate(tiles[tileIndex], image, features); });
+        for (int pass = 0; pass < params_.iterations_; ++pass)
+        {
+            int step = 1 << pass;
+            pool.run(tiles.size(), [&](size_t tileIndex, int)
+                     { filterTile(tiles[tileIndex], step, pass, features); });
+            std::swap(illumination_, filtered_);
+        }
+        pool.run(tiles.size(), [&](size_t tileIndex, int)
+                 { remodulate(tiles[tileIndex], image, features); });
+    }
+
+private:
+    using Planes = std::array<std::vector<float>, 3>;
+
+    static constexpr float kernel[5] = {1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+    static constexpr int chunkWidth = 64;         // Columns filtered together; tiles wider than this are split
+    static constexpr float minimumAlbedo = 1e-3f; // Black surfaces keep their (zero) radiance instead of dividing by zero
+
+    DenoiserParameters params_;
+    Planes illumination_; // Input of the current pass
+    Planes filtered_;     // Output of the current pass
+
+    void demodulate(const Tile &tile, const std::vector<Color3> &image, const AOVBuffers &features)
+    {
+        for (int y = tile.y0_; y < tile.y1_; ++y)
+        {
+            for (int x = tile.x0_; x < tile.x1_; ++x)
+            {
+                size_t p = static_cast<size_t>(y) * features.width_ + x;
+                illumination_[0][p] = static_cast<float>(image[p].red()) / std::max(features.albedo_[0][p], minimumAlbedo);
+                illumination_[1][p] = static_cast<float>(image[p].green()) / std::max(features.albedo_[1][p], minimumAlbedo);
+                illumination_[2][p] = static_cast<float>(image[p].blue()) / std::max(features.albedo_[2][p], minimumAlbedo);
+            }
+        }
+    }
+
+    void remodulate(const Tile &tile, std::vector<Color3> &image, const AOVBuffers &features) const
+    {
+        for (int y = tile.y0_; y < tile.y1_; ++y)
+        {
+            for (int x = tile.x0_; x < tile.x1_; ++x)
+            {
+                size_t p = static_cast<size_t>(y) * features.width_ + x;
+                image[p] = Color3(illumination_[0][p] * std::max(features.albedo_[0][p], minimumAlbedo),
+                                  illumination_[1][p] * std::max(features.albedo_[1][p], minimumAlbedo),
+                                  illumination_[2][p] * std::max(features.albedo_[2][p], minimumAlbedo));
+            }
+        }
+    }
+
+    // One pass over one tile, a row at a time: for each of the 25 taps, a loop along the row that the
+    // compiler vectorises (contiguous loads at p and p + offset, no branches, no calls).
+    void filterTile(const Tile &tile, int step, int pass, const AOVBuffers &features)
+    {
+        const int width = features.width_;
+        const int height = features.height_;
+        const float colorScale = static_cast<float>(std::ldexp(1.0, 2 * pass) / (params_.colorSigma_ * params_.colorSigma_));
+        const float normalScale = static_cast<float>(1.0 / params_.normalSigma_);
+        const float depthScale = static_cast<float>(params_.depthSigma_ * step);
+        const float albedoScale = static_cast<float>(1.0 / (params_.albedoSigma_ * params_.albedoSigma_));
+
+        const float *ir = illumination_[0].data(), *ig = illumination_[1].data(), *ib = illumination_[2].data();
+        const float *ar = features.albedo_[0].data(), *ag = features.albedo_[1].data(), *ab = features.albedo_[2].data();
+        const float *nx = features.normal_[0].data(), *ny = features.normal_[1].data(), *nz = features.normal_[2].data();
+        const float *depth = features.depth_.data();
+
+        for (int y = tile.y0_; y < tile.y1_; ++y)
+        {
+            const ptrdiff_t row = static_cast<ptrdiff_t>(y) * width;
+            for (int x0 = tile.x0_; x0 < tile.x1_; x0 += chunkWidth)
+            {
+                const int x1 = std::min(x0 + chunkWidth, tile.x1_);
+                // Sums live on the stack, where the compiler can see they alias none of the planes
+                float weightSum[chunkWidth] = {}, sumR[chunkWidth] = {}, sumG[chunkWidth] = {}, sumB[chunkWidth] = {};
+                for (int ky = 0; ky < 5; ++ky)
+                {
+                    int qy = y + (ky - 2) * step;
+                    if (qy < 0 || qy >= height)
+                        continue;
+                    for (int kx = 0; kx < 5; ++kx)
+                    {
+                        const int dx = (kx - 2) * step;
+                        const int begin = std::max(x0, -dx);
+                        const int end = std::min(x1, width - dx);
+                        const ptrdiff_t offset = static_cast<ptrdiff_t>(qy - y) * width + dx;
+                        const float tap = kernel[ky] * kernel[kx];
+                        for (int x = begin; x < end; ++x)
+                        {
+                            const ptrdiff_t p = row + x;
+                            const ptrdiff_t q = p + offset;
+                            float dr = ir[p] - ir[q], dg = ig[p] - ig[q], db = ib[p] - ib[q];
+                            float colorTerm = (dr * dr + dg * dg + db * db) * colorScale;
+                            float normalTerm = std::max(0.0f, 1.0f - (nx[p] * nx[q] + ny[p] * ny[q] + nz[p] * nz[q])) * normalScale;
+                            float depthTerm = std::fabs(depth[p] - depth[q]) / (depthScale * std::min(depth[p], depth[q]) + 1e-4f);
+                            float dar = ar[p] - ar[q], dag = ag[p] - ag[q], dab = ab[p] - ab[q];
+                            float albedoTerm = (dar * dar + dag * dag + dab * dab) * albedoScale;
+                            float weight = tap * exponentialDecay(colorTerm + normalTerm + depthTerm + albedoTerm);
+                            const int i = x - x0;
+                            weightSum[i] += weight;
+                            sumR[i] += weight * ir[q];
+                            sumG[i] += weight * ig[q];
+                            sumB[i] += weight * ib[q];
+                        }
+                    }
+                }
+                for (int i = 0; i < x1 - x0; ++i)
+                {
+                    const ptrdiff_t p = row + x0 + i;
+                    float inverse = 1.0f / weightSum[i]; // The centre tap always has weight, so this is never zero
+                    filtered_[0][p] = sumR[i] * inverse;
+                    filtered_[1][p] = sumG[i] * inverse;
+                    filtered_[2][p] = sumB[i] * inverse;
+                }
+            }
+        }
+    }
+};
+
+#endif // RAYTRACER_DENOISER_H
@@ -0,0 +1,577 @@
+#ifndef RAYTRACER_DISTRIBUTED_H
+#define RAYTRACER_DISTRIBUTED_H
+
+// Coordinator/worker tile rendering across processes on one host, over a Unix-domain or local TCP socket.
+// Every process loads the scene itself; only tile assignments and finished tiles cross the socket.
+// Both ends run the same binary on the same machine, so payloads use its native byte order.
+#if !defined(_WIN32)
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <optional>
+#include <poll.h>
+#include <span>
+#include <spawn.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include "Tile.h"
+
+extern char **environ;
+
+// What the coordinator assembles; workers that loaded a scene producing anything else are turned away
+struct FrameSignature
+{
+    uint32_t width_{0};
+    uint32_t height_{0};
+    uint32_t tileCount_{0};
+    uint32_t valuesPerPixel_{0}; // Floats per pixel in a tile result
+
+    bool operator==(const FrameSignature &) const = default;
+};
+
+enum class TileMessageType : uint32_t
+{
+    Hello = 1,  // Worker to coordinator: WorkerHello
+    Assign = 2, // Coordinator to worker: tile index
+    Result = 3, // Worker to coordinator: tile index, then valuesPerPixel_ floats per pixel of the tile, row by row
+    Done = 4    // Coordinator to worker: every tile is in, exit
+};
+
+struct TileMessageHeader
+{
+    TileMessageType type_;
+    uint32_t size_; // Payload bytes after the header
+};
+
+struct WorkerHello
+{
+    FrameSignature signature_;
+    uint32_t threadCount_;
+    int32_t processId_;
+};
+
+// Owned socket descriptor. Sends never raise SIGPIPE; a closed peer shows up as a failed send instead.
+class Socket
+{
+public:
+    Socket() = default;
+    explicit Socket(int fd) : fd_(fd) {}
+    Socket(Socket &&other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+    Socket &operator=(Socket &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            fd_ = std::exchange(other.fd_, -1);
+        }
+        return *this;
+    }
+    Socket(const Socket &) = delete;
+    Socket &operator=(const Socket &) = delete;
+    ~Socket() { close(); }
+
+    int fd() const { return fd_; }
+    bool valid() const { return fd_ >= 0; }
+
+    void close()
+    {
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = -1;
+    }
+
+    bool sendAll(const void *data, size_t size)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            ssize_t sent = ::send(fd_, bytes, size, sendFlags);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent <= 0)
+                return false;
+            bytes += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    // False on end of stream or error
+    bool receiveAll(void *data, size_t size)
+    {
+        char *bytes = static_cast<char *>(data);
+        while (size > 0)
+        {
+            ssize_t received = ::recv(fd_, bytes, size, 0);
+            if (received < 0 && errno == EINTR)
+                continue;
+            if (received <= 0)
+                return false;
+            bytes += received;
+            size -= static_cast<size_t>(received);
+        }
+        return true;
+    }
+
+    bool sendMessage(TileMessageType type, std::span<const std::byte> payload = {}, std::span<const std::byte> more = {})
+    {
+        TileMessageHeader header{type, static_cast<uint32_t>(payload.size() + more.size())};
+        return sendAll(&header, sizeof header) && sendAll(payload.data(), payload.size()) && sendAll(more.data(), more.size());
+    }
+
+    // "host:port" or ":port" is TCP (the host defaults to 127.0.0.1); anything else is a Unix-domain socket path
+    static bool isTcpAddress(const std::string &address) { return address.find(':') != std::string::npos; }
+
+    static Socket listenOn(const std::string &address)
+    {
+        Socket socket;
+        if (isTcpAddress(address))
+        {
+            addrinfo *info = resolve(address, true);
+            socket = Socket(::socket(info->ai_family, info->ai_socktype, info->ai_protocol));
+            int reuse = 1;
+            ::setsockopt(socket.fd(), SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof reuse);
+            int result = socket.valid() ? ::bind(socket.fd(), info->ai_addr, info->ai_addrlen) : -1;
+            freeaddrinfo(info);
+            if (result != 0)
+                fail("bind", address);
+        }
+        else
+        {
+            sockaddr_un unixAddress = unixSocketAddress(address);
+            ::unlink(address.c_str()); // Left behind by a coordinator that did not exit cleanly
+            socket = Socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+            if (!socket.valid() || ::bind(socket.fd(), reinterpret_cast<sockaddr *>(&unixAddress), sizeof unixAddress) != 0)
+                fail("bind", address);
+        }
+        if (::listen(socket.fd(), SOMAXCONN) != 0)
+            fail("listen", address);
+        return socket;
+    }
+
+    // Returns an invalid socket if nothing is listening (yet)
+    static Socket connectTo(const std::string &address)
+    {
+        Socket socket;
+        int result = -1;
+        if (isTcpAddress(address))
+        {
+            addrinfo *info = resolve(address, false);
+            socket = Socket(::socket(info->ai_family, info->ai_socktype, info->ai_protocol));
+            if (socket.valid())
+                result = ::connect(socket.fd(), info->ai_addr, info->ai_addrlen);
+            freeaddrinfo(info);
+        }
+        else
+        {
+            sockaddr_un unixAddress = unixSocketAddress(address);
+            socket = Socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+            if (socket.valid())
+                result = ::connect(socket.fd(), reinterpret_cast<sockaddr *>(&unixAddress), sizeof unixAddress);
+        }
+        if (result != 0)
+            return Socket();
+        socket.disableDelay();
+        return socket;
+    }
+
+    // Tile assignments are a few bytes each and must not wait for more to batch with
+    void disableDelay()
+    {
+        int noDelay = 1;
+        ::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof noDelay); // Fails harmlessly on Unix sockets
+    }
+
+private:
+#if defined(MSG_NOSIGNAL)
+    static constexpr int sendFlags = MSG_NOSIGNAL;
+#else
+    static constexpr int sendFlags = 0;
+#endif
+    int fd_{-1};
+
+    [[noreturn]] static void fail(const char *operation, const std::string &address)
+    {
+        throw std::runtime_error(std::string("Socket: ") + operation + " " + address + ": " + std::strerror(errno));
+    }
+
+    static addrinfo *resolve(const std::string &address, bool passive)
+    {
+        size_t colon = address.rfind(':');
+        std::string host = colon == 0 ? "127.0.0.1" : address.substr(0, colon);
+        std::string port = address.substr(colon + 1);
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = passive ? AI_PASSIVE : 0;
+        addrinfo *info = nullptr;
+        int error = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &info);
+        if (error != 0)
+            throw std::runtime_error("Socket: cannot resolve " + address + ": " + gai_strerror(error));
+        return info;
+    }
+
+    static sockaddr_un unixSocketAddress(const std::string &path)
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof address.sun_path)
+            throw std::runtime_error("Socket: path too long for a Unix-domain socket: " + path);
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return address;
+    }
+};
+
+// Hands out tiles to worker processes and collects their results. Workers may join at any time, including
+// ones it spawns itself. A worker that disconnects has its unfinished tiles requeued; one that returns nothing
+// for stallSeconds has them requeued too, but a late result from it is still accepted if it arrives first.
+class TileCoordinator
+{
+public:
+    using TileHandler = std::function<void(uint32_t tileIndex, std::span<const float> values)>;
+
+    TileCoordinator(const std::string &address, double stallSeconds = 30.0)
+        : address_(address), stallSeconds_(stallSeconds), listener_(Socket::listenOn(address))
+    {
+    }
+
+    TileCoordinator(const TileCoordinator &) = delete;
+    TileCoordinator &operator=(const TileCoordinator &) = delete;
+
+    ~TileCoordinator()
+    {
+        workers_.clear(); // Spawned workers see the connection close and exit
+        listener_.close();
+        if (!Socket::isTcpAddress(address_))
+            ::unlink(address_.c_str());
+        for (pid_t child : children_)
+            ::waitpid(child, nullptr, 0);
+    }
+
+    // Starts count processes running command, which must connect back to this coordinator's address
+    void spawnWorkers(int count, const std::vector<std::string> &command)
+    {
+        std::vector<char *> arguments;
+        for (const std::string &argument : command)
+            arguments.push_back(const_cast<char *>(argument.c_str()));
+        arguments.push_back(nullptr);
+        for (int i = 0; i < count; ++i)
+        {
+            pid_t child;
+            int error = ::posix_spawnp(&child, arguments[0], nullptr, nullptr, arguments.data(), environ);
+            if (error != 0)
+                throw std::runtime_error("TileCoordinator: cannot start " + command[0] + ": " + std::strerror(error));
+            children_.push_back(child);
+        }
+    }
+
+    // Blocks until every tile has come back once; handler sees each tile exactly once, on this thread.
+    // Workers are told to exit afterwards.
+    void run(const std::vector<Tile> &tiles, const FrameSignature &signature, const TileHandler &handler)
+    {
+        std::cout << "Waiting for workers on " << address_ << "\n";
+        state_.assign(tiles.size(), TileState::Queued);
+        queue_.clear();
+        for (uint32_t t = 0; t < tiles.size(); ++t)
+            queue_.push_back(t);
+        size_t remaining = tiles.size();
+        auto lastWorkerSeen = Clock::now();
+        std::vector<float> values;
+
+        while (remaining > 0)
+        {
+            std::vector<pollfd> descriptors{{listener_.fd(), POLLIN, 0}};
+            for (const auto &worker : workers_)
+                descriptors.push_back({worker->socket_.fd(), POLLIN, 0});
+            if (::poll(descriptors.data(), descriptors.size(), pollMilliseconds) < 0 && errno != EINTR)
+                throw std::runtime_error(std::string("TileCoordinator: poll: ") + std::strerror(errno));
+            auto now = Clock::now();
+
+            for (size_t w = 0; w + 1 < descriptors.size(); ++w)
+            {
+                Worker &worker = *workers_[w];
+                if (descriptors[w + 1].revents != 0 && !receive(worker))
+                    worker.lost_ = true;
+                while (!worker.lost_ && nextMessage(worker, tiles, signature, values, now))
+                {
+                    if (worker.finishedTile_ != noTile && state_[worker.finishedTile_] != TileState::Done)
+                    {
+                        handler(worker.finishedTile_, values);
+                        state_[worker.finishedTile_] = TileState::Done;
+                        --remaining;
+                    }
+                }
+            }
+            if (descriptors[0].revents & POLLIN)
+                acceptWorker();
+
+            for (auto &worker : workers_)
+            {
+                if (!worker->lost_ && !worker->stalled_ && !worker->inFlight_.empty() &&
+                    std::chrono::duration<double>(now - worker->lastProgress_).count() > stallSeconds_)
+                {
+                    worker->stalled_ = true;
+                    std::cout << "\nWorker " << worker->processId_ << " stalled: " << requeue(*worker) << " tile(s) reassigned\n";
+                }
+            }
+            removeLostWorkers();
+            assignTiles();
+
+            if (!workers_.empty())
+                lastWorkerSeen = now;
+            else if (std::chrono::duration<double>(now - lastWorkerSeen).count() > stallSeconds_)
+                throw std::runtime_error("TileCoordinator: no workers connected for " + std::to_string(stallSeconds_) +
+                                         " s with " + std::to_string(remaining) + " tile(s) left");
+        }
+
+        for (auto &worker : workers_)
+        {
+            std::cout << "Worker " << worker->processId_ << ": " << worker->tilesRendered_ << " tile(s)\n";
+            worker->socket_.sendMessage(TileMessageType::Done);
+        }
+        workers_.clear();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr int pollMilliseconds = 100;
+    static constexpr uint32_t noTile = UINT32_MAX;
+
+    enum class TileState : uint8_t
+    {
+        Queued,
+        Assigned,
+        Done
+    };
+
+    struct Worker
+    {
+        Socket socket_;
+        std::vector<char> received_; // Bytes read but not yet handled as whole messages
+        int32_t processId_{0};
+        size_t capacity_{0};                // Tiles kept in flight; 0 until the worker has said hello
+        std::vector<uint32_t> inFlight_;    // Assigned and not yet returned
+        Clock::time_point lastProgress_{};  // Last result, or first assignment after being idle
+        uint32_t finishedTile_{noTile};     // Set by nextMessage() when it read a result
+        size_t tilesRendered_{0};
+        bool stalled_{false};
+        bool lost_{false};
+    };
+
+    std::string address_;
+    double stallSeconds_;
+    Socket listener_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<pid_t> children_;
+    std::vector<TileState> state_;
+    std::deque<uint32_t> queue_;
+
+    void acceptWorker()
+    {
+        int fd = ::accept(listener_.fd(), nullptr, nullptr);
+        if (fd < 0)
+            return;
+        auto worker = std::make_unique<Worker>();
+        worker->socket_ = Socket(fd);
+        worker->socket_.disableDelay();
+        workers_.push_back(std::move(worker));
+    }
+
+    // Reads whatever has arrived without blocking; false once the worker has gone
+    bool receive(Worker &worker)
+    {
+        char buffer[1 << 16];
+        ssize_t received = ::recv(worker.socket_.fd(), buffer, sizeof buffer, MSG_DONTWAIT);
+        if (received < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        worker.received_.insert(worker.received_.end(), buffer, buffer + received);
+        return received > 0;
+    }
+
+    // Handles the first whole message in worker's buffer, if there is one. A result's tile index is left in
+    // finishedTile_ and its values in values.
+    bool nextMessage(Worker &worker, const std::vector<Tile> &tiles, const FrameSignature &signature, std::vector<float> &values,
+                     Clock::time_point now)
+    {
+        worker.finishedTile_ = noTile;
+        TileMessageHeader header;
+        if (worker.received_.size() < sizeof header)
+            return false;
+        std::memcpy(&header, worker.received_.data(), sizeof header);
+        if (worker.received_.size() < sizeof header + header.size_)
+            return false;
+        const char *payload = worker.received_.data() + sizeof header;
+
+        if (header.type_ == TileMessageType::Hello && header.size_ == sizeof(WorkerHello))
+        {
+            WorkerHello hello;
+            std::memcpy(&hello, payload, sizeof hello);
+            worker.processId_ = hello.processId_;
+            if (hello.signature_ != signature)
+            {
+                std::cerr << "Worker " << hello.processId_ << " rejected: it loaded a different image size, tiling or set of passes\n";
+                worker.lost_ = true;
+            }
+            else
+            {
+                worker.capacity_ = std::max<uint32_t>(hello.threadCount_, 1) + 1; // One spare hides the round trip
+                std::cout << "Worker " << hello.processId_ << " joined with " << hello.threadCount_ << " thread(s)\n";
+            }
+        }
+        else if (header.type_ == TileMessageType::Result && header.size_ >= sizeof(uint32_t))
+        {
+            uint32_t tileIndex;
+            std::memcpy(&tileIndex, payload, sizeof tileIndex);
+            size_t valueCount = (header.size_ - sizeof tileIndex) / sizeof(float);
+            if (tileIndex >= tiles.size() ||
+                valueCount != static_cast<size_t>(tiles[tileIndex].pixelCount()) * signature.valuesPerPixel_)
+            {
+                std::cerr << "Worker " << worker.processId_ << " sent a malformed tile\n";
+                worker.lost_ = true;
+            }
+            else
+            {
+                values.resize(valueCount);
+                std::memcpy(values.data(), payload + sizeof tileIndex, valueCount * sizeof(float));
+                std::erase(worker.inFlight_, tileIndex);
+                worker.lastProgress_ = now;
+                worker.stalled_ = false;
+                worker.finishedTile_ = tileIndex;
+                ++worker.tilesRendered_;
+            }
+        }
+        else
+        {
+            std::cerr << "Worker " << worker.processId_ << " sent an unexpected message\n";
+            worker.lost_ = true;
+        }
+        worker.received_.erase(worker.received_.begin(), worker.received_.begin() + sizeof header + header.size_);
+        return !worker.lost_;
+    }
+
+    // Puts worker's unfinished tiles back at the front of the queue, so they are handed out next
+    size_t requeue(const Worker &worker)
+    {
+        size_t requeued = 0;
+        for (uint32_t tile : worker.inFlight_)
+        {
+            if (state_[tile] == TileState::Assigned)
+            {
+                state_[tile] = TileState::Queued;
+                queue_.push_front(tile);
+                ++requeued;
+            }
+        }
+        return requeued;
+    }
+
+    void removeLostWorkers()
+    {
+        for (auto &worker : workers_)
+        {
+            if (worker->lost_ && worker->capacity_ > 0)
+                std::cout << "\nWorker " << worker->processId_ << " lost: " << requeue(*worker) << " tile(s) reassigned\n";
+        }
+        std::erase_if(workers_, [](const auto &worker)
+                      { return worker->lost_; });
+    }
+
+    void assignTiles()
+    {
+        for (auto &worker : workers_)
+        {
+            if (worker->stalled_)
+                continue;
+            while (worker->inFlight_.size() < worker->capacity_)
+            {
+                while (!queue_.empty() && state_[queue_.front()] != TileState::Queued)
+                    queue_.pop_front(); // Finished by a stalled worker after all
+                if (queue_.empty())
+                    return;
+                uint32_t tile = queue_.front();
+                if (!worker->socket_.sendMessage(TileMessageType::Assign, std::as_bytes(std::span(&tile, 1))))
+                {
+                    worker->lost_ = true;
+                    break;
+                }
+                queue_.pop_front();
+                state_[tile] = TileState::Assigned;
+                if (worker->inFlight_.empty())
+                    worker->lastProgress_ = Clock::now();
+                worker->inFlight_.push_back(tile);
+            }
+        }
+    }
+};
+
+// A worker's end of the connection. Any number of render threads may wait for tiles and send results at once.
+class TileWorkerConnection
+{
+public:
+    // Retries for retrySeconds, since a worker may be started before its coordinator is listening
+    TileWorkerConnection(const std::string &address, const FrameSignature &signature, int threadCount, double retrySeconds = 10.0)
+    {
+        auto start = std::chrono::steady_clock::now();
+        while (!(socket_ = Socket::connectTo(address)).valid())
+        {
+            if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > retrySeconds)
+                throw std::runtime_error("TileWorkerConnection: no coordinator listening on " + address);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        WorkerHello hello{signature, static_cast<uint32_t>(threadCount), static_cast<int32_t>(::getpid())};
+        if (!socket_.sendMessage(TileMessageType::Hello, std::as_bytes(std::span(&hello, 1))))
+            throw std::runtime_error("TileWorkerConnection: coordinator on " + address + " hung up");
+    }
+
+    // The next tile to render, or nothing once the coordinator is done or gone
+    std::optional<uint32_t> nextTile()
+    {
+        std::lock_guard<std::mutex> lock(receiveMutex_);
+        if (finished_)
+            return std::nullopt;
+        TileMessageHeader header;
+        uint32_t tileIndex;
+        if (!socket_.receiveAll(&header, sizeof header) || header.type_ != TileMessageType::Assign ||
+            header.size_ != sizeof tileIndex || !socket_.receiveAll(&tileIndex, sizeof tileIndex))
+        {
+            finished_ = true;
+            return std::nullopt;
+        }
+        return tileIndex;
+    }
+
+    // A failed send is not an error here: the coordinator has gone, and the next nextTile() says so
+    void sendTile(uint32_t tileIndex, std::span<const float> values)
+    {
+        std::lock_guard<std::mutex> lock(sendMutex_);
+        socket_.sendMessage(TileMessageType::Result, std::as_bytes(std::span(&tileIndex, 1)), std::as_bytes(values));
+    }
+
+private:
+    Socket socket_;
+    std::mutex receiveMutex_;
+    std::mutex sendMutex_;
+    bool finished_{false}; // Guarded by receiveMutex_
+};
+
+#endif // !_WIN32
+
+#endif // RAYTRACER_DISTRIBUTED_H
@@ -2,11 +2,77 @@
 #define RAYTRACER_HELPERFUNCTIONS_H
 
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <optional>
 #include <random>
 
-static thread_local std::mt19937 rng(std::random_device{}());
+// PCG32 (XSH-RR): 16 bytes of state, a handful of instructions per draw, and independent streams
+class PCG32
+{
+public:
+    PCG32(uint64_t seed = 0x853c49e6748fea9bULL, uint64_t stream = 0xda3e39cb94b95bdbULL)
+    {
+        setSeed(seed, stream);
+    }
+
+    void setSeed(uint64_t seed, uint64_t stream)
+    {
+        state_ = 0;
+        increment_ = (stream << 1u) | 1u;
+        nextUInt();
+        state_ += seed;
+        nextUInt();
+    }
+
+    uint32_t nextUInt()
+    {
+        uint64_t oldState = state_;
+        state_ = oldState * 6364136223846793005ULL + increment_;
+        uint32_t xorShifted = static_cast<uint32_t>(((oldState >> 18u) ^ oldState) >> 27u);
+        uint32_t rotation = static_cast<uint32_t>(oldState >> 59u);
+        return (xorShifted >> rotation) | (xorShifted << ((-rotation) & 31u));
+    }
+
+    // Uniform in [0, 1)
+    double nextDouble()
+    {
+        return nextUInt() * 0x1p-32;
+    }
+
+    uint64_t state() const { return state_; }
+    uint64_t increment() const { return increment_; }
+
+private:
+    uint64_t state_;
+    uint64_t increment_;
+};
+
+static thread_local PCG32 rng(std::random_device{}(), std::random_device{}());
+
+// Finalizer of MurmurHash3; turns structured integers (pixel, sample, seed) into well-mixed seeds
+inline uint64_t mixBits(uint64_t v)
+{
+    v ^= v >> 33;
+    v *= 0xff51afd7ed558ccdULL;
+    v ^= v >> 33;
+    v *= 0xc4ceb9fe1a85ec53ULL;
+    v ^= v >> 33;
+    return v;
+}
+
+// Reseeds this thread's generator so the same (seed, stream) always produces the same draws
+inline void seedRandom(uint64_t seed, uint64_t stream)
+{
+    rng.setSeed(mixBits(seed), mixBits(stream));
+}
+
+// Scalar type of vectors, colours, rays and boxes, chosen at build time (CMake option RAYTRACER_PRECISION)
+#if defined(RAYTRACER_SINGLE_PRECISION)
+using Real = float;
+#else
+using Real = double;
+#endif
 
 const double pi = 3.1415926535897932385;
 const double infinity = std::numeric_limits<double>::infinity();
@@ -23,21 +89,20 @@ double radiansToDegrees(double radians)
 
 // Random number generators
 
-double randomDouble(double minimum, double maximum)
+inline double randomDouble0to1()
 {
-    std::uniform_real_distribution<double> distribution(minimum, maximum);
-    return distribution(rng);
+    return rng.nextDouble();
 }
 
-double randomDouble0to1()
+inline double randomDouble(double minimum, double maximum)
 {
-    return randomDouble(0.0, 1.0);
+    return minimum + (maximum - minimum) * rng.nextDouble();
 }
 
-int randomInt(int minimum, int maximum)
+inline int randomInt(int minimum, int maximum)
 {
-    std::uniform_int_distribution<int> distribution(minimum, maximum);
-    return distribution(rng);
+    uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(maximum) - minimum + 1);
+    return minimum + static_cast<int>((rng.nextUInt() * range) >> 32); // Multiply-shift instead of a modulo
 }
 
 double randomInt0to255()
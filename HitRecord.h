@@ -2,10 +2,24 @@
 #ifndef RAYTRACER_HITRECORD_H
 #define RAYTRACER_HITRECORD_H
 
+#include <cstdint>
 #include "Vector3.h"
 #include "Ray.h"
 
-class Material; // Forward declaration
+using MaterialId = uint32_t; // Index into a MaterialTable
+
+class Object;
+
+// What closest-hit traversal carries: the nearest distance so far and enough to rebuild the surface there.
+// The full HitRecord is only computed for the final winner (see Object::rayHit).
+struct PrimitiveHit
+{
+    double distance_{infinity};
+    const Object *primitive_{nullptr}; // Sphere, plane or triangle that was hit
+    const Object *instance_{nullptr};  // Instance the primitive was reached through, if any
+    double u_{0.0};                    // Barycentrics of the second and third triangle corners
+    double v_{0.0};
+};
 
 class HitRecord
 {
@@ -14,7 +28,7 @@ public:
     Vector3 surfaceNormal() const { return surfaceNormal_; }
     double distanceAlongRay() const { return distanceAlongRay_; }
     bool frontFace() const { return frontFace_; }
-    const Material *surfaceMaterial() const { return surfaceMaterial_; }
+    MaterialId materialId() const { return materialId_; }
 
     void setHitPoint(const Point3 &p) { hitPoint_ = p; }
     void setSurfaceNormal(const Vector3 &n) { surfaceNormal_ = n; }
@@ -24,14 +38,14 @@ public:
         frontFace_ = rayDirection.dot(outwardNormal) < 0;
         surfaceNormal_ = frontFace_ ? outwardNormal : -outwardNormal;
     }
-    void setSurfaceMaterial(const Material *m) { surfaceMaterial_ = m; }
+    void setMaterialId(MaterialId id) { materialId_ = id; }
 
 private:
     Point3 hitPoint_;
     Vector3 surfaceNormal_;
     double distanceAlongRay_;
     bool frontFace_;
-    const Material *surfaceMaterial_ = nullptr;
+    MaterialId materialId_ = 0;
 };
 
 #endif // RAYTRACER_HITRECORD_H
@@ -0,0 +1,605 @@
+#ifndef RAYTRACER_IMAGE_WRITER_H
+#define RAYTRACER_IMAGE_WRITER_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Interleaved RGB float image handed to the writer
+struct Image
+{
+    int width_{0};
+    int height_{0};
+    std::vector<float> pixels_; // width_ * height_ * 3 values, top row first
+    bool linear_{true};         // Linear radiance (gamma-corrected for 8-bit formats) or already display-ready
+};
+
+// Named float channels of one size, such as a beauty image plus its AOV passes; written as OpenEXR
+struct LayeredImage
+{
+    struct Channel
+    {
+        std::string name_;          // "R", or "<layer>.<channel>" such as "albedo.G"
+        std::vector<float> values_; // width_ * height_ values, top row first
+    };
+
+    int width_{0};
+    int height_{0};
+    std::vector<Channel> channels_;
+};
+
+enum class ImageFormat
+{
+    PPM, // Binary P6, 8 bits per channel
+    PFM, // Portable float map, linear HDR
+    PNG, // 8-bit RGB, deflate-compressed
+    EXR  // OpenEXR, uncompressed 32-bit float channels
+};
+
+// Chooses the format from the file extension; anything that is not .pfm, .png or .exr is written as binary PPM
+inline ImageFormat imageFormatFor(const std::string &fileName)
+{
+    auto dot = fileName.find_last_of('.');
+    std::string extension = (dot == std::string::npos) ? "" : fileName.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c)
+                   { return std::tolower(c); });
+    if (extension == "pfm")
+        return ImageFormat::PFM;
+    if (extension == "png")
+        return ImageFormat::PNG;
+    if (extension == "exr")
+        return ImageFormat::EXR;
+    return ImageFormat::PPM;
+}
+
+// Encodes and saves images on a background thread so rendering can continue meanwhile.
+// Only one write is in flight at a time; starting another first waits for the previous one.
+class ImageWriter
+{
+public:
+    ImageWriter() = default;
+    ImageWriter(const ImageWriter &) = delete;
+    ImageWriter &operator=(const ImageWriter &) = delete;
+
+    ~ImageWriter()
+    {
+        try
+        {
+            wait();
+        }
+        catch (const std::exception &error)
+        {
+            std::cerr << "Image output failed: " << error.what() << "\n";
+        }
+    }
+
+    void writeAsync(Image image, const std::string &fileName)
+    {
+        wait();
+        pending_ = std::async(std::launch::async, [image = std::move(image), fileName]
+                              { write(image, fileName); });
+    }
+
+    void writeAsync(LayeredImage image, const std::string &fileName)
+    {
+        wait();
+        pending_ = std::async(std::launch::async, [image = std::move(image), fileName]
+                              { save(encodeEXR(image), fileName); });
+    }
+
+    // Blocks until the last write has finished; rethrows its error, if any
+    void wait()
+    {
+        if (pending_.valid())
+            pending_.get();
+    }
+
+    static void write(const Image &image, const std::string &fileName)
+    {
+        std::vector<char> encoded;
+        switch (imageFormatFor(fileName))
+        {
+        case ImageFormat::PPM:
+            encoded = encodePPM(image);
+            break;
+        case ImageFormat::PFM:
+            encoded = encodePFM(image);
+            break;
+        case ImageFormat::PNG:
+            encoded = encodePNG(image);
+            break;
+        case ImageFormat::EXR:
+            encoded = encodeEXR(toLayers(image));
+            break;
+        }
+        save(encoded, fileName);
+    }
+
+    static void save(const std::vector<char> &encoded, const std::string &fileName)
+    {
+        std::ofstream outFile(fileName, std::ios::binary);
+        if (!outFile)
+            throw std::runtime_error("cannot open " + fileName + " for writing");
+        outFile.write(encoded.data(), static_cast<std::streamsize>(encoded.size()));
+        if (!outFile)
+            throw std::runtime_error("failed writing " + fileName);
+    }
+
+    static std::vector<char> encodePPM(const Image &image)
+    {
+        std::string header = "P6\n" + std::to_string(image.width_) + " " + std::to_string(image.height_) + "\n255\n";
+        size_t offset = header.size();
+        std::vector<char> encoded(offset + image.pixels_.size());
+        std::memcpy(encoded.data(), header.data(), offset);
+        quantize(image, reinterpret_cast<uint8_t *>(encoded.data() + offset));
+        return encoded;
+    }
+
+    static std::vector<char> encodePFM(const Image &image)
+    {
+        // A negative scale marks little-endian data; rows are stored bottom to top
+        bool littleEndian = std::endian::native == std::endian::little;
+        std::string header = "PF\n" + std::to_string(image.width_) + " " + std::to_string(image.height_) + "\n" +
+                             (littleEndian ? "-1.0" : "1.0") + "\n";
+        size_t rowBytes = static_cast<size_t>(image.width_) * 3 * sizeof(float);
+        size_t offset = header.size();
+        std::vector<char> encoded(offset + image.pixels_.size() * sizeof(float));
+        std::memcpy(encoded.data(), header.data(), offset);
+        for (int y = 0; y < image.height_; ++y)
+        {
+            const float *row = image.pixels_.data() + static_cast<size_t>(image.height_ - 1 - y) * image.width_ * 3;
+            std::memcpy(encoded.data() + offset + y * rowBytes, row, rowBytes);
+        }
+        return encoded;
+    }
+
+    static std::vector<char> encodePNG(const Image &image)
+    {
+        size_t stride = static_cast<size_t>(image.width_) * 3;
+        std::vector<uint8_t> rgb(stride * image.height_);
+        quantize(image, rgb.data());
+
+        // Each scanline is prefixed with the filter that gives the smallest sum of absolute residuals
+        std::vector<uint8_t> filtered;
+        filtered.reserve((stride + 1) * image.height_);
+        std::vector<uint8_t> candidate(stride);
+        std::vector<uint8_t> best(stride);
+        for (int y = 0; y < image.height_; ++y)
+        {
+            const uint8_t *row = rgb.data() + y * stride;
+            const uint8_t *above = (y > 0) ? row - stride : nullptr;
+            long bestScore = -1;
+            uint8_t bestFilter = 0;
+            for (uint8_t filter = 0; filter < 5; ++filter)
+            {
+                long score = 0;
+                for (size_t x = 0; x < stride; ++x)
+                {
+                    int a = (x >= 3) ? row[x - 3] : 0;
+                    int b = above ? above[x] : 0;
+                    int c = (above && x >= 3) ? above[x - 3] : 0;
+                    int predictor = 0;
+                    switch (filter)
+                    {
+                    case 1: predictor = a; break;
+                    case 2: predictor = b; break;
+                    case 3: predictor = (a + b) / 2; break;
+                    case 4: predictor = paeth(a, b, c); break;
+                    }
+                    candidate[x] = static_cast<uint8_t>(row[x] - predictor);
+                    score += std::abs(static_cast<int8_t>(candidate[x]));
+                }
+                if (bestScore < 0 || score < bestScore)
+                {
+                    bestScore = score;
+                    bestFilter = filter;
+                    best.swap(candidate);
+                }
+            }
+            filtered.push_back(bestFilter);
+            filtered.insert(filtered.end(), best.begin(), best.end());
+        }
+
+        std::vector<char> encoded = {'\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n'};
+        std::vector<uint8_t> header;
+        appendBigEndian(header, static_cast<uint32_t>(image.width_));
+        appendBigEndian(header, static_cast<uint32_t>(image.height_));
+        header.insert(header.end(), {8, 2, 0, 0, 0}); // 8-bit RGB, deflate, adaptive filtering, no interlace
+        appendChunk(encoded, "IHDR", header);
+        appendChunk(encoded, "IDAT", zlibCompress(filtered));
+        appendChunk(encoded, "IEND", {});
+        return encoded;
+    }
+
+    // Scanline OpenEXR with one uncompressed block per row; channels are stored in name order, as the format requires
+    static std::vector<char> encodeEXR(const LayeredImage &image)
+    {
+        std::vector<const LayeredImage::Channel *> channels;
+        for (const LayeredImage::Channel &channel : image.channels_)
+            channels.push_back(&channel);
+        std::sort(channels.begin(), channels.end(), [](const auto *a, const auto *b)
+                  { return a->name_ < b->name_; });
+
+        std::vector<char> encoded = {'\x76', '\x2f', '\x31', '\x01', 2, 0, 0, 0}; // Magic number, version 2, single-part scanline
+        std::vector<char> channelList;
+        for (const LayeredImage::Channel *channel : channels)
+        {
+            channelList.insert(channelList.end(), channel->name_.begin(), channel->name_.end());
+            channelList.push_back('\0');
+            appendLittleEndian(channelList, 2); // FLOAT
+            appendLittleEndian(channelList, 0); // pLinear and three reserved bytes
+            appendLittleEndian(channelList, 1); // x and y sampling
+            appendLittleEndian(channelList, 1);
+        }
+        channelList.push_back('\0');
+        std::vector<char> window;
+        for (int32_t value : {0, 0, image.width_ - 1, image.height_ - 1})
+            appendLittleEndian(window, value);
+        std::vector<char> one;
+        appendLittleEndian(one, std::bit_cast<int32_t>(1.0f));
+
+        appendAttribute(encoded, "channels", "chlist", channelList);
+        appendAttribute(encoded, "compression", "compression", {0});
+        appendAttribute(encoded, "dataWindow", "box2i", window);
+        appendAttribute(encoded, "displayWindow", "box2i", window);
+        appendAttribute(encoded, "lineOrder", "lineOrder", {0}); // Increasing y
+        appendAttribute(encoded, "pixelAspectRatio", "float", one);
+        appendAttribute(encoded, "screenWindowCenter", "v2f", std::vector<char>(8, 0));
+        appendAttribute(encoded, "screenWindowWidth", "float", one);
+        encoded.push_back('\0');
+
+        size_t rowBytes = static_cast<size_t>(image.width_) * channels.size() * sizeof(float);
+        size_t offsetTable = encoded.size();
+        size_t firstRow = offsetTable + static_cast<size_t>(image.height_) * sizeof(uint64_t);
+        encoded.resize(firstRow + static_cast<size_t>(image.height_) * (8 + rowBytes));
+        for (int y = 0; y < image.height_; ++y)
+        {
+            uint64_t rowOffset = firstRow + static_cast<size_t>(y) * (8 + rowBytes);
+            storeLittleEndian(encoded.data() + offsetTable + y * sizeof(uint64_t), rowOffset);
+            char *row = encoded.data() + rowOffset;
+            storeLittleEndian(row, static_cast<uint32_t>(y));
+            storeLittleEndian(row + 4, static_cast<uint32_t>(rowBytes));
+            char *out = row + 8;
+            for (const LayeredImage::Channel *channel : channels)
+            {
+                const float *in = channel->values_.data() + static_cast<size_t>(y) * image.width_;
+                for (int x = 0; x < image.width_; ++x, out += 4)
+                    storeLittleEndian(out, std::bit_cast<uint32_t>(in[x]));
+            }
+        }
+        return encoded;
+    }
+
+    // Splits interleaved RGB into the R, G and B channels of a layered image
+    static LayeredImage toLayers(const Image &image)
+    {
+        LayeredImage layers{image.width_, image.height_, {{"R", {}}, {"G", {}}, {"B", {}}}};
+        size_t pixels = image.pixels_.size() / 3;
+        for (int c = 0; c < 3; ++c)
+        {
+            layers.channels_[c].values_.resize(pixels);
+            for (size_t p = 0; p < pixels; ++p)
+                layers.channels_[c].values_[p] = image.pixels_[3 * p + c];
+        }
+        return layers;
+    }
+
+    // One 8-bit channel value as every 8-bit output stores it
+    static uint8_t quantize(float value, bool linear)
+    {
+        value = std::max(value, 0.0f);
+        if (linear)
+            value = std::sqrt(value); // Same gamma 2 curve as Color3::correctedAverage
+        return static_cast<uint8_t>(256.0f * std::min(value, 0.999f));
+    }
+
+private:
+    std::future<void> pending_;
+
+    template <typename Unsigned>
+    static void storeLittleEndian(char *out, Unsigned value)
+    {
+        for (size_t i = 0; i < sizeof(Unsigned); ++i)
+            out[i] = static_cast<char>(value >> (8 * i));
+    }
+
+    static void appendLittleEndian(std::vector<char> &out, int32_t value)
+    {
+        out.resize(out.size() + 4);
+        storeLittleEndian(out.data() + out.size() - 4, static_cast<uint32_t>(value));
+    }
+
+    static void appendAttribute(std::vector<char> &out, const std::string &name, const std::string &type, const std::vector<char> &value)
+    {
+        out.insert(out.end(), name.begin(), name.end());
+        out.push_back('\0');
+        out.insert(out.end(), type.begin(), type.end());
+        out.push_back('\0');
+        appendLittleEndian(out, static_cast<int32_t>(value.size()));
+        out.insert(out.end(), value.begin(), value.end());
+    }
+
+    static void quantize(const Image &image, uint8_t *out)
+    {
+        for (size_t i = 0; i < image.pixels_.size(); ++i)
+            out[i] = quantize(image.pixels_[i], image.linear_);
+    }
+
+    static int paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc)
+            return a;
+        return (pb <= pc) ? b : c;
+    }
+
+    static void appendBigEndian(std::vector<uint8_t> &out, uint32_t value)
+    {
+        out.insert(out.end(), {uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value)});
+    }
+
+    static uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0)
+    {
+        static const std::array<uint32_t, 256> table = []
+        {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                t[n] = c;
+            }
+            return t;
+        }();
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    static void appendChunk(std::vector<char> &out, const char *type, const std::vector<uint8_t> &data)
+    {
+        std::vector<uint8_t> chunk;
+        appendBigEndian(chunk, static_cast<uint32_t>(data.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        appendBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+        out.insert(out.end(), chunk.begin(), chunk.end());
+    }
+
+    // LSB-first bit stream as required by deflate
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(std::vector<uint8_t> &out) : out_(out) {}
+        void write(uint32_t bits, int count)
+        {
+            buffer_ |= static_cast<uint64_t>(bits) << bitCount_;
+            bitCount_ += count;
+            while (bitCount_ >= 8)
+            {
+                out_.push_back(static_cast<uint8_t>(buffer_));
+                buffer_ >>= 8;
+                bitCount_ -= 8;
+            }
+        }
+        // Huffman codes are defined most significant bit first
+        void writeCode(uint32_t code, int length)
+        {
+            uint32_t reversed = 0;
+            for (int i = 0; i < length; ++i)
+                reversed |= ((code >> i) & 1u) << (length - 1 - i);
+            write(reversed, length);
+        }
+        void flush()
+        {
+            if (bitCount_ > 0)
+                out_.push_back(static_cast<uint8_t>(buffer_));
+            buffer_ = 0;
+            bitCount_ = 0;
+        }
+
+    private:
+        std::vector<uint8_t> &out_;
+        uint64_t buffer_{0};
+        int bitCount_{0};
+    };
+
+    static void writeFixedLiteral(BitWriter &bits, int symbol)
+    {
+        if (symbol < 144)
+            bits.writeCode(0x30 + symbol, 8);
+        else if (symbol < 256)
+            bits.writeCode(0x190 + symbol - 144, 9);
+        else if (symbol < 280)
+            bits.writeCode(symbol - 256, 7);
+        else
+            bits.writeCode(0xc0 + symbol - 280, 8);
+    }
+
+    static void writeMatch(BitWriter &bits, int length, int distance)
+    {
+        static const int lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                           35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const int lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const int distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                             257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        static const int distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                              7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+        int lengthCode = 28;
+        while (lengthBase[lengthCode] > length)
+            --lengthCode;
+        writeFixedLiteral(bits, 257 + lengthCode);
+        bits.write(length - lengthBase[lengthCode], lengthExtra[lengthCode]);
+
+        int distanceCode = 29;
+        while (distanceBase[distanceCode] > distance)
+            --distanceCode;
+        bits.writeCode(distanceCode, 5);
+        bits.write(distance - distanceBase[distanceCode], distanceExtra[distanceCode]);
+    }
+
+    // Single-pass LZ77 with one hash-table candidate per position, coded as one fixed-Huffman block
+    static std::vector<uint8_t> zlibCompress(const std::vector<uint8_t> &data)
+    {
+        constexpr int hashBits = 15;
+        constexpr size_t windowSize = 32768;
+        constexpr size_t maximumMatch = 258;
+
+        std::vector<uint8_t> out = {0x78, 0x01}; // zlib header: deflate, 32K window, fastest
+        BitWriter bits(out);
+        bits.write(1, 1); // Final block
+        bits.write(1, 2); // Fixed Huffman codes
+
+        std::vector<int64_t> head(size_t(1) << hashBits, -1);
+        auto hashAt = [&](size_t i)
+        {
+            uint32_t v = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+            return (v * 2654435761u) >> (32 - hashBits);
+        };
+
+        size_t i = 0;
+        while (i < data.size())
+        {
+            size_t matchLength = 0;
+            size_t matchDistance = 0;
+            if (i + 3 <= data.size())
+            {
+                uint32_t hash = hashAt(i);
+                int64_t candidate = head[hash];
+                head[hash] = static_cast<int64_t>(i);
+                if (candidate >= 0 && i - candidate <= windowSize)
+                {
+                    size_t limit = std::min(maximumMatch, data.size() - i);
+                    while (matchLength < limit && data[candidate + matchLength] == data[i + matchLength])
+                        ++matchLength;
+                    matchDistance = i - candidate;
+                }
+            }
+
+            if (matchLength >= 3)
+            {
+                writeMatch(bits, static_cast<int>(matchLength), static_cast<int>(matchDistance));
+                for (size_t k = 1; k < matchLength && i + k + 3 <= data.size(); ++k)
+                    head[hashAt(i + k)] = static_cast<int64_t>(i + k);
+                i += matchLength;
+            }
+            else
+            {
+                writeFixedLiteral(bits, data[i]);
+                ++i;
+            }
+        }
+        writeFixedLiteral(bits, 256); // End of block
+        bits.flush();
+
+        uint32_t a = 1, b = 0; // Adler-32 of the uncompressed data, reduced every 5552 bytes before b can overflow
+        for (size_t start = 0; start < data.size(); start += 5552)
+        {
+            size_t end = std::min(start + 5552, data.size());
+            for (size_t k = start; k < end; ++k)
+            {
+                a += data[k];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        appendBigEndian(out, (b << 16) | a);
+        return out;
+    }
+};
+
+// Output file that finished tiles are written straight into, at their final position, so the image is never held
+// in memory. Only formats with fixed-size pixels qualify: PPM (quantized as by ImageWriter) and PFM. The file is
+// sized when opened; pixels not written yet read as zero.
+class StreamingImageFile
+{
+public:
+    StreamingImageFile(const std::string &fileName, int width, int height)
+        : fileName_(fileName), format_(imageFormatFor(fileName)), width_(width), height_(height)
+    {
+        std::string header;
+        if (format_ == ImageFormat::PPM)
+            header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        else if (format_ == ImageFormat::PFM)
+            header = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n" +
+                     (std::endian::native == std::endian::little ? "-1.0" : "1.0") + "\n";
+        else
+            throw std::invalid_argument("StreamingImageFile: " + fileName + ": only .ppm and .pfm can be written tile by tile");
+
+        headerSize_ = header.size();
+        file_.open(fileName, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+        if (!file_)
+            throw std::runtime_error("cannot open " + fileName + " for writing");
+        file_.write(header.data(), static_cast<std::streamsize>(header.size()));
+        uint64_t size = headerSize_ + static_cast<uint64_t>(width) * height * pixelBytes();
+        file_.seekp(static_cast<std::streamoff>(size - 1));
+        file_.put('\0');
+        if (!file_)
+            throw std::runtime_error("failed writing " + fileName);
+    }
+
+    // Safe to call from several threads. pixels holds width * height linear RGB values, top row first.
+    // Pixels are converted before the lock is taken, so threads only queue for the seeks and writes.
+    void writeTile(int x0, int y0, int width, int height, std::span<const float> pixels)
+    {
+        size_t rowBytes = static_cast<size_t>(width) * pixelBytes();
+        const char *bytes = reinterpret_cast<const char *>(pixels.data()); // PFM rows are the floats as they are
+        std::vector<char> quantized;
+        if (format_ == ImageFormat::PPM)
+        {
+            quantized.resize(rowBytes * height);
+            for (size_t i = 0; i < quantized.size(); ++i)
+                quantized[i] = static_cast<char>(ImageWriter::quantize(pixels[i], true));
+            bytes = quantized.data();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int y = 0; y < height; ++y)
+        {
+            int fileRow = format_ == ImageFormat::PFM ? height_ - 1 - (y0 + y) : y0 + y; // PFM rows run bottom to top
+            uint64_t offset = headerSize_ + (static_cast<uint64_t>(fileRow) * width_ + x0) * pixelBytes();
+            file_.seekp(static_cast<std::streamoff>(offset));
+            file_.write(bytes + static_cast<size_t>(y) * rowBytes, static_cast<std::streamsize>(rowBytes));
+        }
+        if (!file_)
+            throw std::runtime_error("failed writing " + fileName_);
+    }
+
+    void close()
+    {
+        file_.close();
+        if (!file_)
+            throw std::runtime_error("failed writing " + fileName_);
+    }
+
+private:
+    std::string fileName_;
+    ImageFormat format_;
+    int width_;
+    int height_;
+    size_t headerSize_{0};
+    std::fstream file_;
+    std::mutex mutex_;
+
+    size_t pixelBytes() const { return format_ == ImageFormat::PPM ? 3 : 3 * sizeof(float); }
+};
+
+#endif // RAYTRACER_IMAGE_WRITER_H
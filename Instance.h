@@ -0,0 +1,119 @@
+#ifndef RAYTRACER_INSTANCE_H
+#define RAYTRACER_INSTANCE_H
+
+#include <memory>
+#include <vector>
+#include "Transform.h"
+#include "WideBVH.h"
+
+// Places shared geometry (usually a bottom-level BVH) in the world with an affine transform.
+// Only the transform and a pointer are stored, so every copy of the geometry costs the same few bytes.
+class Instance : public Object
+{
+public:
+    Instance(const Object *geometry, const Transform &objectToWorld)
+        : geometry_{geometry}
+    {
+        setTransform(objectToWorld);
+    }
+
+    // Distances along the untransformed-length direction match in both spaces, so the interval carries over.
+    // Only one level of instancing is recorded: an instance inside an instance is finalised with the outer transform.
+    bool intersect(const Ray &ray, Interval rayInterval, PrimitiveHit &hit) const override
+    {
+        if (!geometry_->intersect(objectToWorld_.inverseApplyToRay(ray), rayInterval, hit))
+            return false;
+        hit.instance_ = this;
+        return true;
+    }
+
+    HitRecord surface(const Ray &ray, const PrimitiveHit &hit) const override
+    {
+        HitRecord rec = hit.primitive_->surface(objectToWorld_.inverseApplyToRay(ray), hit);
+        // The object-space normal already faces the ray, and a linear map keeps that orientation
+        rec.setHitPoint(objectToWorld_.applyToPoint(rec.hitPoint()));
+        rec.setSurfaceNormal(objectToWorld_.applyToNormal(rec.surfaceNormal()).unitVector());
+        return rec;
+    }
+
+    bool occluded(const Ray &ray, Interval rayInterval) const override
+    {
+        return geometry_->occluded(objectToWorld_.inverseApplyToRay(ray), rayInterval);
+    }
+
+    AABB boundingBox() const override
+    {
+        return box_;
+    }
+
+    // Moving an instance only changes its world box; the top level must then be rebuilt or refitted
+    void setTransform(const Transform &objectToWorld)
+    {
+        objectToWorld_ = objectToWorld;
+        box_ = objectToWorld_.applyToBox(geometry_->boundingBox());
+    }
+
+    const Transform &transform() const { return objectToWorld_; }
+    const Object *geometry() const { return geometry_; }
+
+private:
+    const Object *geometry_;
+    Transform objectToWorld_;
+    AABB box_;
+};
+
+// Top-level acceleration structure over instances and other world objects. It does not own them;
+// rebuild() re-reads their boxes and builds from scratch, refit() re-reads them into the existing tree.
+class TopLevelBVH : public Object
+{
+public:
+    explicit TopLevelBVH(std::vector<Object *> objects,
+                         const BVHBuildParameters &params = BVHBuildParameters::defaultParameters())
+        : objects_{std::move(objects)}, params_{params}
+    {
+        rebuild();
+    }
+
+    void rebuild()
+    {
+        // The intermediate binary tree is built in the same arena every time, so rebuilds reuse its blocks
+        {
+            std::vector<Object *> order = objects_; // BVHNode reorders its input
+            BVHNode root(order, 0, order.size(), buildArena_, params_);
+            bvh_ = std::make_unique<WideBVH<preferredBVHWidth>>(root, params_);
+        }
+        buildArena_.reset();
+    }
+
+    // After objects moved: updates the bounds in place, rebuilding only subtrees that degraded too far.
+    // Returns the number of subtrees rebuilt.
+    int refit()
+    {
+        return bvh_->refit(params_);
+    }
+
+    bool intersect(const Ray &ray, Interval rayInterval, PrimitiveHit &hit) const override
+    {
+        return bvh_->intersect(ray, rayInterval, hit);
+    }
+
+    bool occluded(const Ray &ray, Interval rayInterval) const override
+    {
+        return bvh_->occluded(ray, rayInterval);
+    }
+
+    AABB boundingBox() const override
+    {
+        return bvh_->boundingBox();
+    }
+
+    const std::vector<Object *> &objects() const { return objects_; }
+
+private:
+    std::vector<Object *> objects_;
+    BVHBuildParameters params_;
+    Arena buildArena_;
+    std::unique_ptr<WideBVH<preferredBVHWidth>> bvh_;
+};
+
+#endif // RAYTRACER_INSTANCE_H
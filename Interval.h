@@ -35,7 +35,7 @@ private:
     double max_ {-infinity};
 };
 
-const auto Interval::emptyInterval = Interval(+infinity, -infinity);
-const auto Interval::infiniteInterval = Interval(-infinity, +infinity);
+inline const Interval Interval::emptyInterval = Interval(+infinity, -infinity);
+inline const Interval Interval::infiniteInterval = Interval(-infinity, +infinity);
 
 #endif //RAYTRACER_INTERVAL_H
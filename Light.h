@@ -0,0 +1,227 @@
+#ifndef RAYTRACER_LIGHT_H
+#define RAYTRACER_LIGHT_H
+
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+#include "Instance.h"
+#include "Material.h"
+#include "Scene.h"
+#include "TriangleMesh.h"
+
+// Emissive sphere or triangle that shading points sample directly
+struct Light
+{
+    enum class Shape : uint8_t
+    {
+        Sphere,
+        Triangle
+    };
+
+    Shape shape_{Shape::Sphere};
+    Point3 p0_{0, 0, 0}; // Sphere centre, or the first triangle corner
+    Point3 p1_{0, 0, 0};
+    Point3 p2_{0, 0, 0};
+    double radius_{0.0};
+    MaterialId material_{0};
+
+    double area() const
+    {
+        if (shape_ == Shape::Sphere)
+            return 4.0 * pi * radius_ * radius_;
+        return 0.5 * (p1_ - p0_).cross(p2_ - p0_).length();
+    }
+
+    // Uniformly distributed point on the surface
+    Point3 pointOnSurface(double u1, double u2) const
+    {
+        if (shape_ == Shape::Sphere)
+            return p0_ + Vector3::unitVectorFromSamples(u1, u2) * radius_;
+        double root = sqrt(u1);
+        return p0_ * (1.0 - root) + p1_ * (root * (1.0 - u2)) + p2_ * (root * u2);
+    }
+};
+
+// Walker/Vose alias table: draws index i with probability weight[i] / sum in O(1)
+class AliasTable
+{
+public:
+    AliasTable() = default;
+
+    explicit AliasTable(const std::vector<double> &weights)
+    {
+        size_t count = weights.size();
+        probability_.assign(count, 1.0);
+        alias_.resize(count);
+        pmf_.assign(count, count > 0 ? 1.0 / count : 0.0);
+        double total = 0.0;
+        for (double w : weights)
+            total += std::max(w, 0.0);
+        if (count == 0 || total <= 0.0)
+        {
+            for (size_t i = 0; i < count; ++i)
+                alias_[i] = static_cast<uint32_t>(i); // Fall back to uniform selection
+            return;
+        }
+
+        std::vector<double> scaled(count);
+        std::vector<uint32_t> small, large;
+        for (size_t i = 0; i < count; ++i)
+        {
+            pmf_[i] = std::max(weights[i], 0.0) / total;
+            scaled[i] = pmf_[i] * count;
+            (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+        }
+        while (!small.empty() && !large.empty())
+        {
+            uint32_t s = small.back(), l = large.back();
+            small.pop_back();
+            probability_[s] = scaled[s];
+            alias_[s] = l;
+            scaled[l] -= 1.0 - scaled[s];
+            if (scaled[l] < 1.0)
+            {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        // Whatever is left is 1 up to rounding
+        for (uint32_t i : small)
+        {
+            probability_[i] = 1.0;
+            alias_[i] = i;
+        }
+        for (uint32_t i : large)
+        {
+            probability_[i] = 1.0;
+            alias_[i] = i;
+        }
+    }
+
+    // Maps one uniform sample in [0, 1) to an index; the fractional part picks between the column and its alias
+    uint32_t sample(double u) const
+    {
+        double scaled = u * probability_.size();
+        uint32_t column = std::min(static_cast<uint32_t>(scaled), static_cast<uint32_t>(probability_.size() - 1));
+        return (scaled - column < probability_[column]) ? column : alias_[column];
+    }
+
+    double pmf(uint32_t index) const { return pmf_[index]; }
+    size_t size() const { return probability_.size(); }
+
+private:
+    std::vector<double> probability_;
+    std::vector<uint32_t> alias_;
+    std::vector<double> pmf_;
+};
+
+// Every emissive primitive in the scene, picked in proportion to its power (luminance times area)
+class LightSampler
+{
+public:
+    LightSampler() = default;
+
+    // Collects spheres and triangles whose material is Emissive. The triangles of instanced meshes are placed in
+    // the world with their instance's transform, so the sampler must be rebuilt when instances move.
+    LightSampler(const std::vector<Object *> &objects, const MaterialTable &materials)
+    {
+        std::unordered_map<const Object *, std::vector<const Triangle *>> emissiveTriangles; // Per shared geometry
+        for (const Object *object : objects)
+        {
+            if (auto instance = dynamic_cast<const Instance *>(object))
+            {
+                auto found = emissiveTriangles.find(instance->geometry());
+                if (found == emissiveTriangles.end())
+                    found = emissiveTriangles.emplace(instance->geometry(), findEmissiveTriangles(instance->geometry(), materials)).first;
+                for (const Triangle *triangle : found->second)
+                    addTriangle(*triangle, &instance->transform());
+            }
+            else if (auto sphere = dynamic_cast<const Sphere *>(object))
+            {
+                if (materials[sphere->material()].type_ == MaterialType::Emissive)
+                {
+                    Light light;
+                    light.shape_ = Light::Shape::Sphere;
+                    light.p0_ = sphere->centre();
+                    light.radius_ = sphere->radius();
+                    light.material_ = sphere->material();
+                    lights_.push_back(light);
+                }
+            }
+            else if (auto triangle = dynamic_cast<const Triangle *>(object))
+            {
+                if (materials[triangle->mesh().material()].type_ == MaterialType::Emissive)
+                    addTriangle(*triangle, nullptr);
+            }
+        }
+
+        std::vector<double> power;
+        power.reserve(lights_.size());
+        for (const Light &light : lights_)
+            power.push_back(materials[light.material_].color_.luminance() * light.area());
+        table_ = AliasTable(power);
+    }
+
+    bool empty() const { return lights_.empty(); }
+    size_t size() const { return lights_.size(); }
+    const std::vector<Light> &lights() const { return lights_; }
+
+    // Picks a light for the uniform sample u and returns the probability it was picked with
+    const Light &sample(double u, double &probability) const
+    {
+        uint32_t index = table_.sample(u);
+        probability = table_.pmf(index);
+        return lights_[index];
+    }
+
+private:
+    std::vector<Light> lights_;
+    AliasTable table_;
+
+    // Emissive triangles of an instance's geometry, in object space. Other primitives cannot be transformed into
+    // lights, so they are reported rather than silently left unsampled.
+    static std::vector<const Triangle *> findEmissiveTriangles(const Object *geometry, const MaterialTable &materials)
+    {
+        std::vector<const Object *> primitives{geometry};
+        if (auto bvh = dynamic_cast<const WideBVH<preferredBVHWidth> *>(geometry))
+            primitives = bvh->primitives();
+
+        std::vector<const Triangle *> triangles;
+        for (const Object *primitive : primitives)
+        {
+            if (auto triangle = dynamic_cast<const Triangle *>(primitive))
+            {
+                if (materials[triangle->mesh().material()].type_ == MaterialType::Emissive)
+                    triangles.push_back(triangle);
+            }
+            else if (auto sphere = dynamic_cast<const Sphere *>(primitive))
+            {
+                if (materials[sphere->material()].type_ == MaterialType::Emissive)
+                    std::cerr << "Warning: an instanced emissive sphere is not sampled as a light\n";
+            }
+        }
+        return triangles;
+    }
+
+    void addTriangle(const Triangle &triangle, const Transform *objectToWorld)
+    {
+        const TriangleMesh &mesh = triangle.mesh();
+        Point3 corners[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            corners[k] = mesh.position(mesh.vertexIndex(triangle.index(), k));
+            if (objectToWorld)
+                corners[k] = objectToWorld->applyToPoint(corners[k]);
+        }
+        Light light;
+        light.shape_ = Light::Shape::Triangle;
+        light.p0_ = corners[0];
+        light.p1_ = corners[1];
+        light.p2_ = corners[2];
+        light.material_ = mesh.material();
+        lights_.push_back(light);
+    }
+};
+
+#endif // RAYTRACER_LIGHT_H
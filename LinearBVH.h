@@ -0,0 +1,201 @@
+#ifndef RAYTRACER_LINEAR_BVH_H
+#define RAYTRACER_LINEAR_BVH_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "BVHNode.h"
+
+// 32-byte node. Bounds are stored as floats rounded outwards so they never shrink the double-precision box.
+struct alignas(32) LinearBVHNode
+{
+    float boundsMin_[3];
+    float boundsMax_[3];
+    uint32_t offset_;          // Leaf: first primitive. Interior: index of the first of two adjacent children
+    uint16_t primitiveCount_;  // 0 for interior nodes
+    uint8_t axis_;             // Split axis, used to visit the nearer child first
+    uint8_t pad_;
+
+    bool isLeaf() const { return primitiveCount_ > 0; }
+};
+static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode must stay 32 bytes");
+
+class LinearBVH : public Object
+{
+public:
+    static constexpr int traversalStackSize = 64;
+
+    explicit LinearBVH(const BVHNode &root)
+    {
+        nodes_.emplace_back();
+        flatten(root, 0, 1);
+        box_ = root.boundingBox();
+    }
+
+    bool intersect(const Ray &ray, Interval rayInterval, PrimitiveHit &hit) const override
+    {
+        if (primitives_.empty())
+            return false; // Empty scene: the root is a leaf without primitives
+
+        Vector3 origin = ray.origin();
+        Vector3 direction = ray.direction();
+        Vector3 inverseDirection(1.0 / direction.x(), 1.0 / direction.y(), 1.0 / direction.z());
+        bool directionIsNegative[3] = {inverseDirection.x() < 0.0, inverseDirection.y() < 0.0, inverseDirection.z() < 0.0};
+
+        bool hitAnything = false;
+        double closestSoFar = rayInterval.max();
+
+        uint32_t stack[traversalStackSize];
+        int stackSize = 0;
+        uint32_t current = 0;
+        while (true)
+        {
+            const LinearBVHNode &node = nodes_[current];
+            RAYTRACER_COUNT(nodesVisited_, 1);
+            if (nodeHit(node, origin, inverseDirection, rayInterval.min(), closestSoFar))
+            {
+                if (node.isLeaf())
+                {
+                    for (uint32_t i = 0; i < node.primitiveCount_; ++i)
+                    {
+                        RAYTRACER_COUNT(primitiveTests_, 1);
+                        if (primitives_[node.offset_ + i]->intersect(ray, Interval(rayInterval.min(), closestSoFar), hit))
+                        {
+                            hitAnything = true;
+                            closestSoFar = hit.distance_;
+                        }
+                    }
+                }
+                else
+                {
+                    // Visit the child on the near side of the split plane first, defer the other one
+                    uint32_t nearChild = node.offset_ + (directionIsNegative[node.axis_] ? 1 : 0);
+                    uint32_t farChild = node.offset_ + (directionIsNegative[node.axis_] ? 0 : 1);
+                    stack[stackSize++] = farChild;
+                    current = nearChild;
+                    continue;
+                }
+            }
+            if (stackSize == 0)
+                break;
+            current = stack[--stackSize];
+        }
+        return hitAnything;
+    }
+
+    bool occluded(const Ray &ray, Interval rayInterval) const override
+    {
+        if (primitives_.empty())
+            return false;
+
+        Vector3 origin = ray.origin();
+        Vector3 direction = ray.direction();
+        Vector3 inverseDirection(1.0 / direction.x(), 1.0 / direction.y(), 1.0 / direction.z());
+
+        // Any hit ends the query, so child order does not matter
+        uint32_t stack[traversalStackSize];
+        int stackSize = 0;
+        uint32_t current = 0;
+        while (true)
+        {
+            const LinearBVHNode &node = nodes_[current];
+            RAYTRACER_COUNT(nodesVisited_, 1);
+            if (nodeHit(node, origin, inverseDirection, rayInterval.min(), rayInterval.max()))
+            {
+                if (node.isLeaf())
+                {
+                    for (uint32_t i = 0; i < node.primitiveCount_; ++i)
+                    {
+                        RAYTRACER_COUNT(primitiveTests_, 1);
+                        if (primitives_[node.offset_ + i]->occluded(ray, rayInterval))
+                            return true;
+                    }
+                }
+                else
+                {
+                    stack[stackSize++] = node.offset_ + 1;
+                    current = node.offset_;
+                    continue;
+                }
+            }
+            if (stackSize == 0)
+                return false;
+            current = stack[--stackSize];
+        }
+    }
+
+    AABB boundingBox() const override
+    {
+        return box_;
+    }
+
+    const std::vector<LinearBVHNode> &nodes() const { return nodes_; }
+    const std::vector<const Object *> &primitives() const { return primitives_; }
+
+private:
+    std::vector<LinearBVHNode> nodes_;
+    std::vector<const Object *> primitives_; // Leaf primitives stored contiguously in traversal order
+    AABB box_;
+
+    static bool nodeHit(const LinearBVHNode &node, const Vector3 &origin, const Vector3 &inverseDirection, double tMin, double tMax)
+    {
+        for (int axisIndex = 0; axisIndex < 3; ++axisIndex)
+        {
+            double tNear = (node.boundsMin_[axisIndex] - origin[axisIndex]) * inverseDirection[axisIndex];
+            double tFar = (node.boundsMax_[axisIndex] - origin[axisIndex]) * inverseDirection[axisIndex];
+            if (inverseDirection[axisIndex] < 0.0)
+                std::swap(tNear, tFar);
+
+            tMin = std::max(tNear, tMin);
+            tMax = std::min(tFar, tMax);
+            if (tMax <= tMin)
+                return false;
+        }
+        return true;
+    }
+
+    static float roundDown(double value)
+    {
+        float rounded = static_cast<float>(value);
+        return (rounded > value) ? std::nextafter(rounded, -std::numeric_limits<float>::infinity()) : rounded;
+    }
+
+    static float roundUp(double value)
+    {
+        float rounded = static_cast<float>(value);
+        return (rounded < value) ? std::nextafter(rounded, std::numeric_limits<float>::infinity()) : rounded;
+    }
+
+    void flatten(const BVHNode &node, uint32_t index, int depth)
+    {
+        if (depth > traversalStackSize)
+            throw std::length_error("BVH is too deep for the LinearBVH traversal stack");
+
+        const AABB &box = node.boundingBox();
+        LinearBVHNode flat{};
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            flat.boundsMin_[axis] = roundDown(box.min()[axis]);
+            flat.boundsMax_[axis] = roundUp(box.max()[axis]);
+        }
+        flat.axis_ = static_cast<uint8_t>(node.splitAxis());
+
+        if (node.isLeaf())
+        {
+            flat.offset_ = static_cast<uint32_t>(primitives_.size());
+            flat.primitiveCount_ = static_cast<uint16_t>(node.primitives().size());
+            primitives_.insert(primitives_.end(), node.primitives().begin(), node.primitives().end());
+            nodes_[index] = flat;
+            return;
+        }
+
+        uint32_t children = static_cast<uint32_t>(nodes_.size());
+        flat.offset_ = children;
+        nodes_[index] = flat;
+        nodes_.resize(nodes_.size() + 2);
+        flatten(*node.left(), children, depth + 1);
+        flatten(*node.right(), children + 1, depth + 1);
+    }
+};
+
+#endif // RAYTRACER_LINEAR_BVH_H
@@ -0,0 +1,84 @@
+#ifndef RAYTRACER_MAPPED_FILE_H
+#define RAYTRACER_MAPPED_FILE_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+#include <fstream>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file. Uses mmap where available so large files are paged in on demand
+// instead of being copied; other platforms fall back to reading the file into memory.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path)
+    {
+#if defined(_WIN32)
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in)
+            throw std::runtime_error("cannot open " + path);
+        buffer_.resize(static_cast<size_t>(in.tellg()));
+        in.seekg(0);
+        in.read(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("cannot open " + path);
+        struct stat info;
+        if (::fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("cannot stat " + path);
+        }
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ > 0)
+        {
+            void *mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("cannot map " + path);
+            }
+            ::madvise(mapping, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char *>(mapping);
+        }
+        ::close(fd); // The mapping stays valid after the descriptor is closed
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile()
+    {
+#if !defined(_WIN32)
+        if (data_ != nullptr)
+            ::munmap(const_cast<char *>(data_), size_);
+#endif
+    }
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+    const char *begin() const { return data_; }
+    const char *end() const { return data_ + size_; }
+
+private:
+    const char *data_{nullptr};
+    size_t size_{0};
+#if defined(_WIN32)
+    std::vector<char> buffer_;
+#endif
+};
+
+#endif // RAYTRACER_MAPPED_FILE_H
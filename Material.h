@@ -4,187 +4,139 @@
 #include "Color3.h"
 #include "Vector3.h"
 #include "Ray.h"
-#include <optional>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #include "HitRecord.h"
 
-class Material
+enum class MaterialType : uint8_t
 {
-public:
-    virtual std::optional<Ray> scatter(const Ray &ray, const HitRecord &hitRecord) const = 0;
-    virtual Color3 color() const = 0;
-    virtual ~Material() = default;
-    virtual Color3 emittedColor() const
-    {
-        return Color3(0, 0, 0); // Default implementation returns no emission
-    }
+    PureDiffuse, // Lambertian
+    Reflective,  // Perfect mirror (metal)
+    Glossy,      // Mirror direction blurred by glossiness
+    Emissive,    // Light source, does not scatter
+    Checker,     // Lambertian with a two-colour checker pattern in x/z
+    Dielectric   // Glass: Schlick-weighted reflection or refraction
 };
 
-// --- PureDiffuse (Lambertian) ---
-class PureDiffuse : public Material
+// Tagged material record. Materials are plain data stored in a MaterialTable and
+// evaluated by one switch in shadeMaterial(), so shading needs no virtual calls or RTTI.
+struct Material
 {
-public:
-    PureDiffuse(Color3 color) : albedo_(color) {}
-
-    inline std::optional<Ray> scatter(const Ray &, const HitRecord &hitRecord) const override
-    {
-        Vector3 scatterDirection = hitRecord.surfaceNormal() + Vector3::randomUnitVector();
-        if (scatterDirection.nearZero())
-            scatterDirection = hitRecord.surfaceNormal();
-        return Ray(hitRecord.hitPoint(), scatterDirection);
-    }
-
-    inline Color3 color() const override
-    {
-        return albedo_;
-    }
-
-private:
-    Color3 albedo_;
+    MaterialType type_{MaterialType::PureDiffuse};
+    Color3 color_{0.0, 0.0, 0.0};       // Albedo, emitted colour, or the first checker colour
+    Color3 secondColor_{0.0, 0.0, 0.0}; // Second checker colour
+    double parameter_{0.0};             // Glossiness, checker scale or refractive index
 };
 
-// --- Reflective (Metal) ---
-class Reflective : public Material
+// Contiguous array of materials; primitives and hit records refer to entries by MaterialId
+class MaterialTable
 {
 public:
-    Reflective(Color3 color) : albedo_(color) {}
-
-    inline std::optional<Ray> scatter(const Ray &ray, const HitRecord &hitRecord) const override
-    {
-        Vector3 reflectedDirection = ray.direction().unitVector().reflectionAboutNormalVector(hitRecord.surfaceNormal());
-        return Ray(hitRecord.hitPoint(), reflectedDirection);
-    }
-
-    inline Color3 color() const override
+    MaterialId add(const Material &material)
     {
-        return albedo_;
+        materials_.push_back(material);
+        return static_cast<MaterialId>(materials_.size() - 1);
     }
 
-private:
-    Color3 albedo_;
-};
+    const Material &operator[](MaterialId id) const { return materials_[id]; }
 
-class Glossy : public Material
-{
-public:
-    Glossy(Color3 color, double gloss = 0.0) : albedo_(color), glossiness_(std::clamp(gloss, 0.0, 1.0)) {}
-    inline std::optional<Ray> scatter(const Ray &ray, const HitRecord &hitRecord) const override
+    const Material &at(MaterialId id) const
     {
-        Vector3 reflectedDirection = ray.direction().unitVector().reflectionAboutNormalVector(hitRecord.surfaceNormal());
-
-        Vector3 glossyDirection = reflectedDirection + Vector3::randomInUnitSphere() * glossiness_;
-        if (glossyDirection.dot(hitRecord.surfaceNormal()) <= 0)
-            glossyDirection = hitRecord.surfaceNormal();
-        return Ray(hitRecord.hitPoint(), glossyDirection);
-    }
-    inline Color3 color() const override
-    {
-        return albedo_;
+        if (id >= materials_.size())
+            throw std::out_of_range("unknown material id " + std::to_string(id));
+        return materials_[id];
     }
 
+    size_t size() const { return materials_.size(); }
+
 private:
-    Color3 albedo_;
-    double glossiness_;
+    std::vector<Material> materials_;
 };
 
-// --- Emissive (Light Source) ---
-class Emissive : public Material
+// What a surface does with one incoming ray
+struct MaterialSample
 {
-public:
-    Emissive(Color3 color) : emittedColor_(color) {}
-    inline std::optional<Ray> scatter(const Ray &, const HitRecord &) const override
-    {
-        return std::nullopt; // Emissive materials do not scatter rays
-    }
-    inline Color3 color() const override
-    {
-        return emittedColor_;
-    }
-    inline Color3 emittedColor() const override
-    {
-        return emittedColor_; // Return the emitted color
-    }
-
-private:
-    Color3 emittedColor_;
+    Color3 baseColor_{0.0, 0.0, 0.0};
+    Color3 emittedColor_{0.0, 0.0, 0.0};
+    bool scattered_{false};
+    Vector3 scatteredDirection_{0.0, 0.0, 0.0}; // Leaves from the hit point; only set when scattered_
 };
 
-// --- Checker (Simple Checker) --- (Caro)
-class Checker : public Material
+inline double schlickReflectance(double cosineTheta, double refractiveIndexRatio)
 {
-public:
-    Checker(Color3 color1, Color3 color2, double scale = 1.0)
-        : color1_(color1), color2_(color2), scale_(scale) {}
+    double r0 = (1 - refractiveIndexRatio) / (1 + refractiveIndexRatio);
+    r0 *= r0;
+    return r0 + (1 - r0) * pow((1 - cosineTheta), 5);
+}
 
-    std::optional<Ray> scatter(const Ray &, const HitRecord &rec) const override
-    {
-        Vector3 scatterDir = rec.surfaceNormal() + Vector3::randomUnitVector();
-        if (scatterDir.nearZero())
-            scatterDir = rec.surfaceNormal();
-        return Ray(rec.hitPoint(), scatterDir);
-    }
-
-    Color3 color() const override
-    {
-        return Color3(1, 1, 1); // not used directly
-    }
-
-    Color3 emittedColor() const override
-    {
-        return Color3(0, 0, 0);
-    }
-
-    Color3 checkerColorAt(const Point3 &p) const
-    {
-        // checker based on x and z only (for horizontal plane)
-        int check = static_cast<int>(floor(p.x() * scale_)) + static_cast<int>(floor(p.z() * scale_));
-        return (check % 2 == 0) ? color1_ : color2_;
-    }
-
-private:
-    Color3 color1_, color2_;
-    double scale_;
-};
-// -- Dielectric (Transparent) ---
-class Dielectric : public Material
+// The shading kernel: colour, emission and scattered direction for every material type
+inline MaterialSample shadeMaterial(const Material &material, const Ray &ray, const HitRecord &hitRecord)
 {
-public:
-    Dielectric(double refractiveIndex) : refractiveIndex_(refractiveIndex) {}
-    std::optional<Ray> scatter(const Ray &ray, const HitRecord &hitRecord) const override
+    MaterialSample sample;
+    const Vector3 normal = hitRecord.surfaceNormal();
+    switch (material.type_)
     {
-        double refractionRatio = hitRecord.frontFace() ? (1.0 / refractiveIndex_) : refractiveIndex_;
-
-        Vector3 unitDirection = ray.direction().unitVector();
-        double cosTheta = std::min((-unitDirection).dot(hitRecord.surfaceNormal()), 1.0);
-        double sinTheta = sqrt(1.0 - cosTheta * cosTheta);
-
-        bool cannotRefract = refractionRatio * sinTheta > 1.0;
-        Vector3 scatterDirection;
-        if (cannotRefract || reflectance(cosTheta, refractionRatio) > randomDouble0to1())
+    case MaterialType::PureDiffuse:
+    case MaterialType::Checker:
+    {
+        if (material.type_ == MaterialType::Checker)
         {
-            // Reflect
-            scatterDirection = unitDirection.reflectionAboutNormalVector(hitRecord.surfaceNormal());
+            // Checker based on x and z only (for horizontal plane)
+            const Point3 p = hitRecord.hitPoint();
+            int check = static_cast<int>(floor(p.x() * material.parameter_)) + static_cast<int>(floor(p.z() * material.parameter_));
+            sample.baseColor_ = (check % 2 == 0) ? material.color_ : material.secondColor_;
         }
         else
         {
-            // Refract
-            scatterDirection = unitDirection.refractionAboutNormalVector(hitRecord.surfaceNormal(), refractionRatio);
+            sample.baseColor_ = material.color_;
         }
-        return Ray(hitRecord.hitPoint(), scatterDirection);
-    }
+        Vector3 scatterDirection = normal + Vector3::randomUnitVector();
+        if (scatterDirection.nearZero())
+            scatterDirection = normal;
+        sample.scattered_ = true;
+        sample.scatteredDirection_ = scatterDirection;
+        break;
+    }
+    case MaterialType::Reflective:
+        sample.baseColor_ = material.color_;
+        sample.scattered_ = true;
+        sample.scatteredDirection_ = ray.direction().unitVector().reflectionAboutNormalVector(normal);
+        break;
+    case MaterialType::Glossy:
+    {
+        sample.baseColor_ = material.color_;
+        Vector3 reflectedDirection = ray.direction().unitVector().reflectionAboutNormalVector(normal);
+        Vector3 glossyDirection = reflectedDirection + Vector3::randomInUnitSphere() * material.parameter_;
+        if (glossyDirection.dot(normal) <= 0)
+            glossyDirection = normal;
+        sample.scattered_ = true;
+        sample.scatteredDirection_ = glossyDirection;
+        break;
+    }
+    case MaterialType::Emissive:
+        sample.baseColor_ = material.color_;
+        sample.emittedColor_ = material.color_; // Emissive materials do not scatter rays
+        break;
+    case MaterialType::Dielectric:
+    {
+        sample.baseColor_ = Color3(1, 1, 1);
+        double refractionRatio = hitRecord.frontFace() ? (1.0 / material.parameter_) : material.parameter_;
+        Vector3 unitDirection = ray.direction().unitVector();
+        double cosTheta = std::min<double>((-unitDirection).dot(normal), 1.0);
+        double sinTheta = sqrt(1.0 - cosTheta * cosTheta);
 
-    Color3 color() const override
-    {
-        return Color3(1, 1, 1); // not used directly
+        bool cannotRefract = refractionRatio * sinTheta > 1.0;
+        if (cannotRefract || schlickReflectance(cosTheta, refractionRatio) > randomDouble0to1())
+            sample.scatteredDirection_ = unitDirection.reflectionAboutNormalVector(normal);
+        else
+            sample.scatteredDirection_ = unitDirection.refractionAboutNormalVector(normal, refractionRatio);
+        sample.scattered_ = true;
+        break;
     }
-
-private:
-    double refractiveIndex_;
-    static double reflectance(double cosineTheta, double refractiveIndexRatio)
-    {
-        // Schlick's approximation for reflectance
-        double r0 = (1 - refractiveIndexRatio) / (1 + refractiveIndexRatio);
-        r0 *= r0;
-        return r0 + (1 - r0) * pow((1 - cosineTheta), 5);
     }
-};
+    return sample;
+}
+
 #endif // RAYTRACER_MATERIAL_H
@@ -1,40 +1,42 @@
 #ifndef RAYTRACER_MATERIAL_FACTORY_H
 #define RAYTRACER_MATERIAL_FACTORY_H
 
+#include <algorithm>
 #include "Material.h"
 
+// Front end that registers materials in a MaterialTable and returns their ids
 class MaterialFactory
 {
 public:
-    static const Material *createReflective(const Color3 &color)
+    static MaterialId createReflective(MaterialTable &table, const Color3 &color)
     {
-        return new Reflective(color);
+        return table.add({MaterialType::Reflective, color});
     }
 
-    static const Material *createGlossy(const Color3 &color, double glossiness)
+    static MaterialId createGlossy(MaterialTable &table, const Color3 &color, double glossiness)
     {
-        return new Glossy(color, glossiness);
+        return table.add({MaterialType::Glossy, color, Color3(0, 0, 0), std::clamp(glossiness, 0.0, 1.0)});
     }
 
-    static const Material *createDiffuse(const Color3 &color)
+    static MaterialId createDiffuse(MaterialTable &table, const Color3 &color)
     {
-        return new PureDiffuse(color);
+        return table.add({MaterialType::PureDiffuse, color});
     }
 
-    static const Material *createEmissive(const Color3 &color)
+    static MaterialId createEmissive(MaterialTable &table, const Color3 &color)
     {
-        return new Emissive(color);
+        return table.add({MaterialType::Emissive, color});
     }
 
-    static const Material *createChecker(const Color3 &color1, const Color3 &color2, double scale)
+    static MaterialId createChecker(MaterialTable &table, const Color3 &color1, const Color3 &color2, double scale)
     {
-        return new Checker(color1, color2, scale);
+        return table.add({MaterialType::Checker, color1, color2, scale});
     }
 
-    static const Material *createDielectric(double refractiveIndex)
+    static MaterialId createDielectric(MaterialTable &table, double refractiveIndex)
     {
-        return new Dielectric(refractiveIndex);
+        return table.add({MaterialType::Dielectric, Color3(1, 1, 1), Color3(0, 0, 0), refractiveIndex});
     }
 };
 
-#endif // RAYTRACER_MATERIAL_FACTORY_H
\ No newline at end of file
+#endif // RAYTRACER_MATERIAL_FACTORY_H
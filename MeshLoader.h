@@ -0,0 +1,437 @@
+#ifndef RAYTRACER_MESH_LOADER_H
+#define RAYTRACER_MESH_LOADER_H
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "MappedFile.h"
+#include "TriangleMesh.h"
+
+// Parsers for Wavefront OBJ and binary PLY. Files are memory-mapped and scanned in place;
+// numbers are parsed straight out of the mapping with std::from_chars, so no line is ever copied.
+namespace MeshLoader
+{
+    namespace detail
+    {
+        inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+        inline void skipSpaces(const char *&cursor, const char *end)
+        {
+            while (cursor < end && isSpace(*cursor))
+                ++cursor;
+        }
+
+        inline void skipLine(const char *&cursor, const char *end)
+        {
+            const char *newline = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+            cursor = newline ? newline + 1 : end;
+        }
+
+        inline float parseFloat(const char *&cursor, const char *end)
+        {
+            skipSpaces(cursor, end);
+            if (cursor < end && *cursor == '+')
+                ++cursor; // from_chars does not accept a leading plus
+            float value = 0.0f;
+            auto [next, error] = std::from_chars(cursor, end, value);
+            if (error != std::errc())
+                throw std::runtime_error("OBJ: malformed number");
+            cursor = next;
+            return value;
+        }
+
+        inline bool parseInt(const char *&cursor, const char *end, long &value)
+        {
+            auto [next, error] = std::from_chars(cursor, end, value);
+            if (error != std::errc())
+                return false;
+            cursor = next;
+            return true;
+        }
+
+        // OBJ indices are 1-based; negative ones count back from the latest element
+        inline uint32_t resolveIndex(long index, size_t count)
+        {
+            long resolved = (index < 0) ? static_cast<long>(count) + index : index - 1;
+            if (resolved < 0 || static_cast<size_t>(resolved) >= count)
+                throw std::runtime_error("OBJ: face index out of range");
+            return static_cast<uint32_t>(resolved);
+        }
+
+        template <typename T>
+        T readScalar(const char *data, bool swapBytes)
+        {
+            T value;
+            std::memcpy(&value, data, sizeof(T));
+            if (swapBytes)
+            {
+                char bytes[sizeof(T)];
+                std::memcpy(bytes, &value, sizeof(T));
+                std::reverse(bytes, bytes + sizeof(T));
+                std::memcpy(&value, bytes, sizeof(T));
+            }
+            return value;
+        }
+    }
+
+    // Loads positions, normals and polygonal faces (fan-triangulated). Texture coordinates are skipped.
+    // A mesh vertex is created for every distinct position/normal pair used by the faces.
+    inline std::unique_ptr<TriangleMesh> loadOBJ(const std::string &path, MaterialId material)
+    {
+        using namespace detail;
+        MappedFile file(path);
+        const char *cursor = file.begin();
+        const char *end = file.end();
+
+        std::vector<float> positions;
+        std::vector<float> normals;
+        positions.reserve(file.size() / 16); // Rough guess that avoids most regrowth on large files
+
+        auto mesh = std::make_unique<TriangleMesh>(material);
+        std::unordered_map<uint64_t, uint32_t> vertexIds; // (position, normal) pairs
+        std::vector<uint32_t> plainVertexIds;             // Positions used without a normal, the common case
+        const uint32_t unassigned = UINT32_MAX;
+        std::vector<uint32_t> polygon;
+        bool meshHasNormals = true;
+
+        while (cursor < end)
+        {
+            skipSpaces(cursor, end);
+            if (cursor + 1 < end && cursor[0] == 'v' && isSpace(cursor[1]))
+            {
+                ++cursor;
+                for (int k = 0; k < 3; ++k)
+                    positions.push_back(parseFloat(cursor, end));
+            }
+            else if (cursor + 2 < end && cursor[0] == 'v' && cursor[1] == 'n' && isSpace(cursor[2]))
+            {
+                cursor += 2;
+                for (int k = 0; k < 3; ++k)
+                    normals.push_back(parseFloat(cursor, end));
+            }
+            else if (cursor + 1 < end && cursor[0] == 'f' && isSpace(cursor[1]))
+            {
+                ++cursor;
+                polygon.clear();
+                while (true)
+                {
+                    skipSpaces(cursor, end);
+                    long positionIndex;
+                    if (cursor >= end || !parseInt(cursor, end, positionIndex))
+                        break;
+
+                    // Corner forms: v, v/vt, v/vt/vn, v//vn
+                    long normalIndex = 0;
+                    if (cursor < end && *cursor == '/')
+                    {
+                        ++cursor;
+                        long ignored;
+                        parseInt(cursor, end, ignored);
+                        if (cursor < end && *cursor == '/')
+                        {
+                            ++cursor;
+                            parseInt(cursor, end, normalIndex);
+                        }
+                    }
+
+                    uint32_t position = resolveIndex(positionIndex, positions.size() / 3);
+                    uint32_t normal = 0;
+                    if (normalIndex != 0)
+                        normal = resolveIndex(normalIndex, normals.size() / 3) + 1;
+                    else
+                        meshHasNormals = false;
+
+                    uint32_t *vertexId;
+                    if (normal == 0)
+                    {
+                        if (plainVertexIds.size() <= position)
+                            plainVertexIds.resize(positions.size() / 3, unassigned);
+                        vertexId = &plainVertexIds[position];
+                    }
+                    else
+                    {
+                        vertexId = &vertexIds.try_emplace((static_cast<uint64_t>(position) << 32) | normal, unassigned).first->second;
+                    }
+                    if (*vertexId == unassigned)
+                    {
+                        *vertexId = mesh->addVertex(positions[3 * position], positions[3 * position + 1], positions[3 * position + 2]);
+                        if (normal != 0)
+                            mesh->addNormal(normals[3 * (normal - 1)], normals[3 * (normal - 1) + 1], normals[3 * (normal - 1) + 2]);
+                        else
+                            mesh->addNormal(0.0f, 0.0f, 0.0f);
+                    }
+                    polygon.push_back(*vertexId);
+                }
+                if (polygon.size() < 3)
+                    throw std::runtime_error("OBJ: face with fewer than three vertices in " + path);
+                for (size_t k = 1; k + 1 < polygon.size(); ++k)
+                    mesh->addTriangle(polygon[0], polygon[k], polygon[k + 1]);
+            }
+            skipLine(cursor, end);
+        }
+
+        if (!meshHasNormals)
+            mesh->clearNormals(); // Partial normals would shade inconsistently; use flat normals throughout
+        return mesh;
+    }
+
+    // Loads a binary (little or big endian) PLY with a vertex element holding float or double x/y/z
+    // and optional nx/ny/nz, and a face element whose first property is the vertex index list.
+    inline std::unique_ptr<TriangleMesh> loadPLY(const std::string &path, MaterialId material)
+    {
+        using namespace detail;
+        MappedFile file(path);
+        const char *cursor = file.begin();
+        const char *end = file.end();
+
+        struct Property
+        {
+            std::string_view name_;
+            int size_;           // Bytes of a scalar, or of each list entry
+            bool isFloat_;
+            bool isSigned_;
+            bool isList_{false};
+            int countSize_{0};   // Bytes of the list length
+            bool countSigned_{false};
+            size_t offset_{0};   // Offset inside the element record, for fixed-size elements
+        };
+        struct Element
+        {
+            std::string_view name_;
+            size_t count_{0};
+            std::vector<Property> properties_;
+        };
+
+        auto scalarSize = [&](std::string_view type, bool &isFloat, bool &isSigned)
+        {
+            isFloat = (type == "float" || type == "float32" || type == "double" || type == "float64");
+            isSigned = (type == "char" || type == "int8" || type == "short" || type == "int16" || type == "int" || type == "int32");
+            if (type == "char" || type == "uchar" || type == "int8" || type == "uint8")
+                return 1;
+            if (type == "short" || type == "ushort" || type == "int16" || type == "uint16")
+                return 2;
+            if (type == "int" || type == "uint" || type == "int32" || type == "uint32" || type == "float" || type == "float32")
+                return 4;
+            if (type == "double" || type == "float64")
+                return 8;
+            throw std::runtime_error("PLY: unknown property type in " + path);
+        };
+
+        auto nextWord = [&]()
+        {
+            skipSpaces(cursor, end);
+            const char *start = cursor;
+            while (cursor < end && !isSpace(*cursor) && *cursor != '\n')
+                ++cursor;
+            return std::string_view(start, cursor - start);
+        };
+
+        if (nextWord() != "ply")
+            throw std::runtime_error("PLY: missing magic in " + path);
+        skipLine(cursor, end);
+
+        bool swapBytes = false;
+        std::vector<Element> elements;
+        while (true)
+        {
+            if (cursor >= end)
+                throw std::runtime_error("PLY: unterminated header in " + path);
+            std::string_view keyword = nextWord();
+            if (keyword == "format")
+            {
+                std::string_view format = nextWord();
+                if (format == "binary_little_endian")
+                    swapBytes = std::endian::native != std::endian::little;
+                else if (format == "binary_big_endian")
+                    swapBytes = std::endian::native != std::endian::big;
+                else
+                    throw std::runtime_error("PLY: only binary files are supported, " + path + " is " + std::string(format));
+            }
+            else if (keyword == "element")
+            {
+                Element element;
+                element.name_ = nextWord();
+                std::string_view count = nextWord();
+                auto [next, error] = std::from_chars(count.data(), count.data() + count.size(), element.count_);
+                if (error != std::errc() || next != count.data() + count.size())
+                    throw std::runtime_error("PLY: malformed count for element " + std::string(element.name_) + " in " + path);
+                elements.push_back(element);
+            }
+            else if (keyword == "property")
+            {
+                if (elements.empty())
+                    throw std::runtime_error("PLY: property before element in " + path);
+                Property property{};
+                std::string_view type = nextWord();
+                if (type == "list")
+                {
+                    bool ignored;
+                    property.isList_ = true;
+                    property.countSize_ = scalarSize(nextWord(), ignored, property.countSigned_);
+                    property.size_ = scalarSize(nextWord(), property.isFloat_, property.isSigned_);
+                }
+                else
+                {
+                    property.size_ = scalarSize(type, property.isFloat_, property.isSigned_);
+                }
+                property.name_ = nextWord();
+                elements.back().properties_.push_back(property);
+            }
+            else if (keyword == "end_header")
+            {
+                skipLine(cursor, end);
+                break;
+            }
+            skipLine(cursor, end);
+        }
+
+        // Signed types are sign-extended, so a negative count or index stays negative and is rejected
+        auto readInteger = [&](const char *data, int size, bool isSigned) -> int64_t
+        {
+            switch (size)
+            {
+            case 1: return isSigned ? int64_t{static_cast<int8_t>(*data)} : int64_t{static_cast<uint8_t>(*data)};
+            case 2: return isSigned ? int64_t{readScalar<int16_t>(data, swapBytes)} : int64_t{readScalar<uint16_t>(data, swapBytes)};
+            default: return isSigned ? int64_t{readScalar<int32_t>(data, swapBytes)} : int64_t{readScalar<uint32_t>(data, swapBytes)};
+            }
+        };
+        auto readFloat = [&](const char *data, const Property &property) -> float
+        {
+            if (property.isFloat_)
+                return (property.size_ == 8) ? static_cast<float>(readScalar<double>(data, swapBytes)) : readScalar<float>(data, swapBytes);
+            return static_cast<float>(readInteger(data, property.size_, property.isSigned_));
+        };
+        // Bytes taken by count fixed-size records, or throws if the file holds fewer
+        auto checkedBytes = [&](size_t recordSize, size_t count, std::string_view what) -> size_t
+        {
+            if ((recordSize != 0 && count > std::numeric_limits<size_t>::max() / recordSize) ||
+                static_cast<size_t>(end - cursor) < recordSize * count)
+                throw std::runtime_error("PLY: truncated " + std::string(what) + " data in " + path);
+            return recordSize * count;
+        };
+
+        auto mesh = std::make_unique<TriangleMesh>(material);
+        for (Element &element : elements)
+        {
+            bool fixedSize = std::none_of(element.properties_.begin(), element.properties_.end(), [](const Property &p)
+                                          { return p.isList_; });
+            size_t recordSize = 0;
+            for (Property &property : element.properties_)
+            {
+                property.offset_ = recordSize;
+                recordSize += property.size_;
+            }
+
+            if (element.name_ == "vertex")
+            {
+                if (!fixedSize)
+                    throw std::runtime_error("PLY: list property on vertices in " + path);
+                const Property *position[3] = {};
+                const Property *normal[3] = {};
+                for (const Property &property : element.properties_)
+                {
+                    const char *names[] = {"x", "y", "z", "nx", "ny", "nz"};
+                    for (int k = 0; k < 6; ++k)
+                    {
+                        if (property.name_ == names[k])
+                            (k < 3 ? position[k] : normal[k - 3]) = &property;
+                    }
+                }
+                if (!position[0] || !position[1] || !position[2])
+                    throw std::runtime_error("PLY: vertices without x/y/z in " + path);
+                bool withNormals = normal[0] && normal[1] && normal[2];
+
+                checkedBytes(recordSize, element.count_, "vertex");
+                mesh->reserve(element.count_, 0);
+                for (size_t v = 0; v < element.count_; ++v, cursor += recordSize)
+                {
+                    mesh->addVertex(readFloat(cursor + position[0]->offset_, *position[0]),
+                                    readFloat(cursor + position[1]->offset_, *position[1]),
+                                    readFloat(cursor + position[2]->offset_, *position[2]));
+                    if (withNormals)
+                        mesh->addNormal(readFloat(cursor + normal[0]->offset_, *normal[0]),
+                                        readFloat(cursor + normal[1]->offset_, *normal[1]),
+                                        readFloat(cursor + normal[2]->offset_, *normal[2]));
+                }
+            }
+            else if (element.name_ == "face")
+            {
+                if (element.properties_.empty() || !element.properties_[0].isList_)
+                    throw std::runtime_error("PLY: face element without a leading index list in " + path);
+                const Property &list = element.properties_[0];
+                mesh->reserve(mesh->vertexCount(), element.count_);
+                uint32_t polygon[256];
+                for (size_t f = 0; f < element.count_; ++f)
+                {
+                    // Fields after the index list are read past, one by one, since lists make records variable-sized
+                    for (size_t p = 0; p < element.properties_.size(); ++p)
+                    {
+                        const Property &property = element.properties_[p];
+                        size_t count = 1;
+                        if (property.isList_)
+                        {
+                            if (end - cursor < property.countSize_)
+                                throw std::runtime_error("PLY: truncated face data in " + path);
+                            int64_t length = readInteger(cursor, property.countSize_, property.countSigned_);
+                            if (length < 0)
+                                throw std::runtime_error("PLY: negative list length in " + path);
+                            count = static_cast<size_t>(length);
+                            cursor += property.countSize_;
+                        }
+                        checkedBytes(property.size_, count, "face");
+                        if (p == 0)
+                        {
+                            if (count < 3 || count > 256)
+                                throw std::runtime_error("PLY: unsupported polygon size in " + path);
+                            for (size_t k = 0; k < count; ++k)
+                            {
+                                int64_t index = readInteger(cursor + k * list.size_, list.size_, list.isSigned_);
+                                if (index < 0 || static_cast<uint64_t>(index) >= mesh->vertexCount())
+                                    throw std::runtime_error("PLY: face index out of range in " + path);
+                                polygon[k] = static_cast<uint32_t>(index);
+                            }
+                            for (size_t k = 1; k + 1 < count; ++k)
+                                mesh->addTriangle(polygon[0], polygon[k], polygon[k + 1]);
+                        }
+                        cursor += count * property.size_;
+                    }
+                }
+            }
+            else if (fixedSize)
+            {
+                cursor += checkedBytes(recordSize, element.count_, element.name_); // Elements we do not use
+            }
+            else
+            {
+                throw std::runtime_error("PLY: cannot skip variable-sized element " + std::string(element.name_) + " in " + path);
+            }
+        }
+        return mesh;
+    }
+
+    // Picks the parser from the file extension
+    inline std::unique_ptr<TriangleMesh> loadMesh(const std::string &path, MaterialId material)
+    {
+        auto dot = path.find_last_of('.');
+        std::string extension = (dot == std::string::npos) ? "" : path.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c)
+                       { return std::tolower(c); });
+        if (extension == "obj")
+            return loadOBJ(path, material);
+        if (extension == "ply")
+            return loadPLY(path, material);
+        throw std::runtime_error("unsupported mesh format: " + path);
+    }
+}
+
+#endif // RAYTRACER_MESH_LOADER_H
@@ -3,15 +3,18 @@
 
 #include "Vector3.h"
 
-class Ray {
+template <typename Scalar>
+class RayT {
 public:
-    Ray(const Point3& o, const Vector3& d) : origin_{o}, direction_{d} {};
-    Point3 origin() const { return origin_; }
-    Vector3 direction() const { return direction_; }
-    Vector3 pointAlongRay(double distance) const { return origin() + (direction() * distance); }
+    RayT(const Vector3T<Scalar>& o, const Vector3T<Scalar>& d) : origin_{o}, direction_{d} {};
+    const Vector3T<Scalar>& origin() const { return origin_; }
+    const Vector3T<Scalar>& direction() const { return direction_; }
+    Vector3T<Scalar> pointAlongRay(double distance) const { return origin() + (direction() * static_cast<Scalar>(distance)); }
 private:
-    Point3 origin_;
-    Vector3 direction_;
+    Vector3T<Scalar> origin_;
+    Vector3T<Scalar> direction_;
 };
 
+using Ray = RayT<Real>;
+
 #endif //RAYTRACER_RAY_H
@@ -2,11 +2,22 @@
 #define RAYTRACER_RENDERER_H
 
 #include <fstream>
+#include <iomanip>
+#include <mutex>
 
+#include "AOV.h"
 #include "Camera.h"
+#include "Checkpoint.h"
 #include "Color3.h"
+#include "Denoiser.h"
+#include "Distributed.h"
+#include "ImageWriter.h"
+#include "Light.h"
+#include "Sampler.h"
 #include "Scene.h"
-#include <thread>
+#include "Statistics.h"
+#include "ThreadPool.h"
+#include "Tile.h"
 
 class RendererParameters
 {
@@ -14,9 +25,29 @@ public:
     int imageWidth_{512};
     int imageHeight_{512};
     int samplesPerPixel_{10};
-    int maximumRecursionDepth_{25};
+    SamplerType samplerType_{SamplerType::Sobol};
+    uint64_t randomSeed_{0}; // Same seed, same image, regardless of thread scheduling
+    bool adaptiveSampling_{false};        // Stop sampling a pixel once its estimate has converged
+    int minimumSamplesPerPixel_{16};      // Adaptive: samples taken before convergence is tested
+    int maximumSamplesPerPixel_{256};     // Adaptive: cap for pixels that never converge
+    double adaptiveErrorThreshold_{0.02}; // Adaptive: target standard error of the mean, relative to pixel luminance
+    std::string sampleHeatmapFileName_{}; // Adaptive: if set, samples taken per pixel are written here as an image
+    int maximumRecursionDepth_{25};       // Longest path, in bounces; paths are traced in a loop, so this does not grow the stack
+    int russianRouletteMinimumDepth_{3};  // Bounces before low-throughput paths may be ended by Russian roulette
+    int lightSamples_{10};                // Direct-light samples per shading point, each from one power-weighted light
+    int threadCount_{0}; // 0 uses every hardware thread
+    int tileSize_{16};   // Tiles are tileSize_ x tileSize_ pixels
     Color3 backgroundColor_{0.0, 0.0, 0.0};
-    std::string fileName_{"image.ppm"};
+    std::string fileName_{"image.ppm"}; // .ppm (binary P6), .pfm (linear float), .png or .exr (OpenEXR)
+    std::string traceFileName_{};       // If set (and built with RAYTRACER_STATISTICS), a Chrome/Perfetto trace of tile execution
+    bool denoise_{false};               // Filter the image, guided by first-hit albedo, normal and depth, before writing it
+    DenoiserParameters denoiser_{DenoiserParameters::defaultParameters()};
+    uint32_t aovPasses_{0};                  // Bitwise OR of AOVPass values filled in alongside the image
+    std::string aovFileName_{"passes.exr"}; // AOVs: multi-layer OpenEXR holding the image and every selected pass
+    int samplesPerPass_{0};                  // Progressive: samples added to every pixel per pass; 0 is one pass, or 16 per pass with a checkpoint
+    std::string checkpointFileName_{};       // If set, accumulated sums are saved here between passes and a render resumes from them
+    double checkpointIntervalSeconds_{60.0}; // Checkpoint: least time between saves; the last pass is always saved
+    bool streamOutput_{false};               // Write finished tiles straight into fileName_ (.ppm or .pfm); memory no longer grows with the image
     static RendererParameters defaultParameters()
     {
         return RendererParameters();
@@ -26,76 +57,217 @@ public:
 class Renderer
 {
 public:
-    Renderer(const Camera &camera, const RendererParameters &params) : camera_(camera), params_(params), frameBuffer_(params.imageWidth_ * params.imageHeight_),
-                                                                       rowsCompleted_(0) {}
-    void render(const Object &world, const Sphere *lightSource = nullptr)
+    Renderer(const Camera &camera, const RendererParameters &params) : camera_(camera), params_(params), frameBuffer_(bufferedPixels(params)),
+                                                                       sampleSums_(bufferedPixels(params)),
+                                                                       sampleCounts_(bufferedPixels(params)),
+                                                                       threadPool_(params.threadCount_), tilesCompleted_(0)
     {
-        std::cout << "Rendering with " << std::thread::hardware_concurrency() << " threads...\n";
-        renderMultithread(world, lightSource);
-        writeOutput(params_.fileName_);
+        if (params_.streamOutput_ && (params_.denoise_ || params_.aovPasses_ || params_.samplesPerPass_ > 0 ||
+                                      !params_.checkpointFileName_.empty() || !params_.sampleHeatmapFileName_.empty()))
+            throw std::invalid_argument("Renderer: streamed output needs no whole-image buffers, so it cannot be combined with "
+                                        "denoising, AOVs, progressive passes, checkpoints or a sample heatmap");
+        uint32_t passes = params_.aovPasses_;
+        if (params_.denoise_)
+            passes |= AlbedoPass | NormalPass | DepthPass; // The denoiser's guides
+        if (passes)
+            aovs_.allocate(params_.imageWidth_, params_.imageHeight_, passes);
     }
 
+    void render(const Object &world, const MaterialTable &materials, const LightSampler &lights)
+    {
+        materials_ = &materials;
+        std::cout << "Rendering with " << threadPool_.threadCount() << " threads...\n";
+        auto renderStart = std::chrono::steady_clock::now();
+        if (params_.streamOutput_)
+        {
+            renderStreamed(world, lights); // The image is already written; statistics are all that is left
+            double renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+            std::cout << "Rendered in " << renderSeconds << " s\n";
+            reportThreadBalance();
+            reportStatistics(renderSeconds);
+            return;
+        }
+        renderMultithread(world, lights);
+        double renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+        reportThreadBalance();
+        finishFrame(renderSeconds);
+    }
+
+    // For animations: later renders use this camera and write <name>_<frame>.<extension> instead of each output file.
+    // Threads, buffers and the image writer carry over, so a frame costs no more setup than the first.
+    void setFrame(const Camera &camera, int frame)
+    {
+        camera_ = camera;
+        frame_ = frame;
+    }
+
+    int threadCount() const { return threadPool_.threadCount(); }
+
+#if !defined(_WIN32)
+    // What a distributed render's workers and coordinator must agree on; it follows from the parameters alone
+    FrameSignature frameSignature() const
+    {
+        return {static_cast<uint32_t>(params_.imageWidth_), static_cast<uint32_t>(params_.imageHeight_),
+                static_cast<uint32_t>(makeTiles(params_.imageWidth_, params_.imageHeight_, params_.tileSize_).size()),
+                static_cast<uint32_t>(4 + aovs_.planeCount())};
+    }
+
+    // Worker process of a distributed render: every thread renders the tiles the coordinator assigns and sends
+    // each one back, until the coordinator has them all. No image is written here; the ray statistics of this
+    // worker's tiles are reported here, since the coordinator's stay at zero.
+    void renderForCoordinator(const Object &world, const MaterialTable &materials, const LightSampler &lights,
+                              TileWorkerConnection &connection)
+    {
+        materials_ = &materials;
+        auto renderStart = std::chrono::steady_clock::now();
+        tiles_ = makeTiles(params_.imageWidth_, params_.imageHeight_, params_.tileSize_);
+        clearAccumulation();
+        statistics_.start(threadPool_.threadCount());
+        threadPool_.run(threadPool_.threadCount(), [&](size_t, int worker)
+                        {
+                            std::vector<float> payload;
+                            while (std::optional<uint32_t> tileIndex = connection.nextTile())
+                            {
+                                renderTile(*tileIndex, worker, world, lights, 0, params_.samplesPerPixel_);
+                                packTile(tiles_[*tileIndex], payload);
+                                connection.sendTile(*tileIndex, payload);
+                            } });
+        double renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+        reportThreadBalance();
+        if constexpr (statisticsEnabled)
+            statistics_.report(renderSeconds);
+    }
+
+    // Coordinator of a distributed render: worker processes render every tile, which is merged into this
+    // renderer's buffers; the frame is then denoised and written as by render()
+    void renderWithWorkers(TileCoordinator &coordinator)
+    {
+        auto renderStart = std::chrono::steady_clock::now();
+        tiles_ = makeTiles(params_.imageWidth_, params_.imageHeight_, params_.tileSize_);
+        tilesCompleted_ = 0;
+        progressTotal_ = tiles_.size();
+        lastReportedPercent_ = -1;
+        statistics_.start(threadPool_.threadCount()); // Counters stay at zero: the workers trace the rays and report them
+        coordinator.run(tiles_, frameSignature(), [&](uint32_t tileIndex, std::span<const float> values)
+                        {
+                            unpackTile(tiles_[tileIndex], values);
+                            updateProgressBar(++tilesCompleted_); });
+        std::cout << "\n";
+        double renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+        std::cout << "Rendered by workers in " << renderSeconds << " s\n";
+        finishFrame(renderSeconds);
+    }
+#endif
+
 private:
     Camera camera_;
     RendererParameters params_;
-    std::vector<Color3> frameBuffer_;
-    std::atomic<int> rowsCompleted_;
+    std::vector<Color3> frameBuffer_; // Linear average radiance per pixel
+    std::vector<Color3> sampleSums_;  // Unnormalised radiance per pixel, over its sampleCounts_ samples
+    std::vector<int> sampleCounts_;   // Samples taken per pixel
+    AOVBuffers aovs_;                 // Selected AOV passes plus the denoiser's guides; empty when neither is wanted
+    ThreadPool threadPool_;
+    RenderStatistics statistics_;
+    ImageWriter imageWriter_; // Declared after the buffers so pending writes finish before they go away
+    std::vector<Tile> tiles_;
+    std::atomic<int> tilesCompleted_;
+    size_t progressTotal_{1}; // Tile renders in the whole frame, over every pass
+    std::atomic<int> lastReportedPercent_{-1};
+    std::mutex progressMutex_; // Keeps bar updates whole and in increasing order
+    const MaterialTable *materials_{nullptr}; // Set for the duration of render()
+    int frame_{-1};                           // Animation frame being rendered, or -1 for a still
 
-    Color3 rayColor(const Ray &ray, const Object &world, int depth = 10, const Sphere *lightSource = nullptr)
+    // Iterative path tracer. Each bounce adds emitted and direct light weighted by the path throughput;
+    // after russianRouletteMinimumDepth_ bounces a path survives with probability equal to its throughput
+    // (capped) and is reweighted by the inverse, which keeps the estimate unbiased.
+    // If aovs is given, the first hit's features and the path's direct lighting are added to it.
+    Color3 rayColor(const Ray &cameraRay, const Object &world, Sampler &sampler, int maximumDepth, const LightSampler &lights,
+                    PixelAOVs *aovs = nullptr)
     {
-        if (depth <= 0)
+        Color3 radiance(0, 0, 0);
+        Color3 throughput(1, 1, 1);
+        Ray ray = cameraRay;
+        int depth = 0;
+        for (; depth < maximumDepth; ++depth)
         {
-            return Color3(0, 0, 0); // Ray bounces exhausted
-        }
+            RAYTRACER_COUNT(bounceRays_, depth > 0);
+            auto hitRecordOpt = world.rayHit(ray, Interval(0.001, infinity));
+            if (!hitRecordOpt)
+            {
+                radiance += throughput * backgroundColor(ray);
+                if (aovs && depth == 0)
+                {
+                    aovs->addFirstHit(backgroundColor(ray), Vector3(0, 0, 0), PixelAOVs::missDepth, PixelAOVs::skyMaterialId);
+                    aovs->addDirect(radiance);
+                }
+                break;
+            }
+            RAYTRACER_COUNT(hits_, 1);
 
-        auto hitRecordOpt = world.rayHit(ray, Interval(0.001, infinity));
-        if (hitRecordOpt)
-        {
             const HitRecord &rec = *hitRecordOpt;
-            const Material *material = rec.surfaceMaterial();
+            const MaterialSample surface = shadeMaterial((*materials_)[rec.materialId()], ray, rec);
+            if (aovs && depth == 0)
+                aovs->addFirstHit(surface.baseColor_, rec.surfaceNormal(), (rec.hitPoint() - ray.origin()).length(),
+                                  static_cast<int>(rec.materialId()));
+            radiance += throughput * surface.emittedColor_;
+            if (surface.scattered_)
+                radiance += throughput * directLight(rec, surface.baseColor_, world, sampler, lights);
+            if (aovs && depth == 0)
+                aovs->addDirect(radiance); // Everything gathered so far came straight from an emitter
+            if (!surface.scattered_)
+                break; // Emitters do not reflect light, including their own (a near-zero shadow ray there is a firefly in float)
 
-            Color3 baseColor = material->color();
-            if (auto checkerMat = dynamic_cast<const Checker *>(material))
-            {
-                baseColor = checkerMat->checkerColorAt(rec.hitPoint());
-            }
-            const Color3 emittedColor = material->emittedColor();
+            ray = Ray(rec.hitPoint(), surface.scatteredDirection_);
+            double cosine = std::max<double>(0.0, rec.surfaceNormal().dot(ray.direction().unitVector()));
+            throughput = throughput * surface.baseColor_ * (cosine * (1.0 / pi)); // Apply Lambertian reflectance
 
-            // Calculate indirect light contribution
-            Color3 indirectLight = Color3(0, 0, 0);
-            if (auto reflected = material->scatter(ray, rec))
+            if (depth + 1 >= params_.russianRouletteMinimumDepth_)
             {
-                Color3 incoming = rayColor(*reflected, world, depth - 1, lightSource);
-                double cosine = std::max(0.0, rec.surfaceNormal().dot(reflected->direction().unitVector()));
-                indirectLight = baseColor * incoming * (cosine * (1.0 / pi)); // Apply Lambertian reflectance
+                double survival = std::min<double>(std::max({throughput.red(), throughput.green(), throughput.blue()}), 0.95);
+                if (survival <= 0.0 || randomDouble0to1() >= survival)
+                    break;
+                throughput /= survival;
             }
+        }
+        RAYTRACER_COUNT_PATH(std::min(depth + 1, maximumDepth));
+        return radiance;
+    }
 
-            // Calculate direct light contribution if a light source is provided
-            Color3 directLight = Color3(0, 0, 0);
-            if (lightSource != nullptr)
+    // Light arriving straight from emitters. Each sample picks one light by power and divides by the
+    // probability of that pick, so the cost does not grow with the number of lights.
+    Color3 directLight(const HitRecord &rec, const Color3 &baseColor, const Object &world, Sampler &sampler, const LightSampler &lights)
+    {
+        Color3 directLight = Color3(0, 0, 0);
+        int lightSamples = params_.lightSamples_;
+        if (lights.empty() || lightSamples <= 0)
+            return directLight;
+
+        for (int i = 0; i < lightSamples; ++i)
+        {
+            double selectionProbability;
+            const Light &light = lights.sample(sampler.get1D(), selectionProbability);
+            Sample2D lightSample = sampler.get2D();
+            Point3 lightSamplePoint = light.pointOnSurface(lightSample.u_, lightSample.v_); // Sample a point on the chosen light
+            Vector3 lightDirection = (lightSamplePoint - rec.hitPoint()).unitVector();
+            double lightDistance = (lightSamplePoint - rec.hitPoint()).length();
+            Ray shadowRay(rec.hitPoint(), lightDirection);
+            RAYTRACER_COUNT(shadowRays_, 1);
+            bool inShadow = world.occluded(shadowRay, Interval(0.01, lightDistance - 0.01));
+            if (!inShadow)
             {
-                int lightSamples = 10; // Number of samples for direct light
-                for (int i = 0; i < lightSamples; ++i)
-                {
-                    Point3 lightSamplePoint = lightSource->randomPointOnSurface(); // Sample a point on the light source
-                    Vector3 lightDirection = (lightSamplePoint - rec.hitPoint()).unitVector();
-                    double lightDistance = (lightSamplePoint - rec.hitPoint()).length();
-                    Ray shadowRay(rec.hitPoint(), lightDirection);
-                    bool inShadow = world.rayHit(shadowRay, Interval(0.01, lightDistance - 0.01)).has_value();
-                    if (!inShadow)
-                    {
-                        // If not in shadow, add direct light contribution
-                        double cosine = std::max(0.0, rec.surfaceNormal().dot(lightDirection));
-                        double attenuation = 1.0 / (lightDistance * lightDistance); // Simple attenuation
-                        Color3 lightIntensity = lightSource->material()->emittedColor() * attenuation * cosine;
-                        directLight += baseColor * lightIntensity; // Direct light contribution
-                    }
-                }
-                directLight /= static_cast<double>(lightSamples); // Average direct light contribution
+                // If not in shadow, add direct light contribution
+                double cosine = std::max<double>(0.0, rec.surfaceNormal().dot(lightDirection));
+                double attenuation = 1.0 / (lightDistance * lightDistance); // Simple attenuation
+                Color3 lightIntensity = (*materials_)[light.material_].color_ * (attenuation * cosine / selectionProbability);
+                directLight += baseColor * lightIntensity; // Direct light contribution
             }
-            return emittedColor + indirectLight + directLight; // Combine emitted, indirect, and direct light contributions
         }
+        directLight /= static_cast<double>(lightSamples); // Average direct light contribution
+        return directLight;
+    }
 
+    static Color3 backgroundColor(const Ray &ray)
+    {
         // Background gradient
         auto unitDirection = ray.direction().unitVector();
         auto verticalBlendFactor = 0.5 * (unitDirection.y() + 1.0);
@@ -106,64 +278,404 @@ private:
         // return Color3(0, 0, 0); // Night sky background
     }
 
-    void updateProgressBar(int rowsDone)
+    void updateProgressBar(int tilesDone)
     {
-        float percent = ((float)rowsDone / params_.imageHeight_) * 100.0f;
+        int percent = static_cast<int>((100LL * tilesDone) / static_cast<long long>(progressTotal_));
+        if (percent <= lastReportedPercent_.load())
+            return;
+        std::lock_guard<std::mutex> lock(progressMutex_);
+        if (percent <= lastReportedPercent_.load())
+            return; // Another worker printed this or a later percentage while we waited
+        lastReportedPercent_ = percent;
         std::cout << "[";
         for (int i = 0; i < 50; ++i)
             std::cout << (i < percent / 2 ? "#" : " ");
         std::cout << "] " << percent << "%\r" << std::flush;
     }
 
-    void renderRows(int startRow, int endRow, const Object &world, const Sphere *lightSource)
+    Color3 traceSample(int i, int j, int sampleIndex, const Object &world, const LightSampler &lights, Sampler &sampler,
+                       PixelAOVs *aovs)
+    {
+        sampler.startPixelSample(i, j, sampleIndex);
+        Sample2D jitter = sampler.get2D();
+        Ray ray = camera_.getRay(i + jitter.u_, j + jitter.v_);
+        RAYTRACER_COUNT(cameraRays_, 1);
+        return rayColor(ray, world, sampler, params_.maximumRecursionDepth_, lights, aovs);
+    }
+
+    // Adds samples [firstSample, endSample) of every pixel in the tile to its sums; adaptive sampling decides for itself.
+    // With streamedPixels the tile's averages go there instead, as RGB row by row, and the image buffers are untouched.
+    void renderTile(size_t tileIndex, int worker, const Object &world, const LightSampler &lights, int firstSample, int endSample,
+                    float *streamedPixels = nullptr)
     {
-        for (int j = startRow; j < endRow; ++j)
+        const Tile &tile = tiles_[tileIndex];
+        auto tileStart = statistics_.beginTile();
+        // Strata must cover every sample a pixel can take, which under adaptive sampling is its maximum
+        int pixelSampleLimit = params_.adaptiveSampling_ ? params_.maximumSamplesPerPixel_ : params_.samplesPerPixel_;
+        std::unique_ptr<Sampler> sampler = makeSampler(params_.samplerType_, pixelSampleLimit, params_.randomSeed_);
+        for (int j = tile.y0_; j < tile.y1_; ++j)
         {
-            for (int i = 0; i < params_.imageWidth_; ++i)
+            for (int i = tile.x0_; i < tile.x1_; ++i)
             {
-                Color3 pixelColor;
-                for (int s = 0; s < params_.samplesPerPixel_; ++s)
+                Color3 colorSum;
+                PixelAOVs aovSums;
+                PixelAOVs *aovs = aovs_.enabled() ? &aovSums : nullptr;
+                int samples = endSample - firstSample;
+                if (params_.adaptiveSampling_)
+                {
+                    samples = sampleAdaptively(i, j, world, lights, *sampler, colorSum, aovs);
+                }
+                else
                 {
-                    Ray ray = camera_.getRay(i + randomDouble0to1(), j + randomDouble0to1());
-                    pixelColor += rayColor(ray, world, params_.maximumRecursionDepth_, lightSource);
+                    for (int s = firstSample; s < endSample; ++s)
+                        colorSum += traceSample(i, j, s, world, lights, *sampler, aovs);
                 }
-                frameBuffer_[j * params_.imageWidth_ + i] = pixelColor.correctedAverage(params_.samplesPerPixel_);
+                if (streamedPixels)
+                {
+                    Color3 average = colorSum * (1.0 / samples);
+                    float *out = streamedPixels + 3 * (static_cast<size_t>(j - tile.y0_) * tile.width() + (i - tile.x0_));
+                    out[0] = static_cast<float>(average.red());
+                    out[1] = static_cast<float>(average.green());
+                    out[2] = static_cast<float>(average.blue());
+                    continue;
+                }
+                size_t pixel = static_cast<size_t>(j) * params_.imageWidth_ + i;
+                int previousSamples = sampleCounts_[pixel];
+                sampleSums_[pixel] += colorSum;
+                sampleCounts_[pixel] = previousSamples + samples;
+                frameBuffer_[pixel] = sampleSums_[pixel] * (1.0 / sampleCounts_[pixel]);
+                if (aovs)
+                    aovs_.store(pixel, aovSums, samples, previousSamples, colorSum);
             }
-            updateProgressBar(++rowsCompleted_);
         }
+        statistics_.endTile(worker, static_cast<int>(tileIndex), tile, tileStart);
     }
 
-    void renderMultithread(const Object &world, const Sphere *lightSource)
+#if !defined(_WIN32)
+    // Distributed tile payload, per pixel: the average colour, the sample count, then one value from every AOV plane
+    void packTile(const Tile &tile, std::vector<float> &payload)
     {
-        int threadCount = std::thread::hardware_concurrency();
-        std::vector<std::thread> threads;
-        int rowsPerThread = params_.imageHeight_ / threadCount;
+        std::vector<std::vector<float> *> planes = aovs_.planes();
+        payload.clear();
+        payload.reserve(static_cast<size_t>(tile.pixelCount()) * (4 + planes.size()));
+        for (int j = tile.y0_; j < tile.y1_; ++j)
+        {
+            for (int i = tile.x0_; i < tile.x1_; ++i)
+            {
+                size_t pixel = static_cast<size_t>(j) * params_.imageWidth_ + i;
+                payload.insert(payload.end(), {static_cast<float>(frameBuffer_[pixel].red()), static_cast<float>(frameBuffer_[pixel].green()),
+                                               static_cast<float>(frameBuffer_[pixel].blue()), static_cast<float>(sampleCounts_[pixel])});
+                for (const std::vector<float> *plane : planes)
+                    payload.push_back((*plane)[pixel]);
+            }
+        }
+    }
 
-        for (int t = 0; t < threadCount; ++t)
+    void unpackTile(const Tile &tile, std::span<const float> payload)
+    {
+        std::vector<std::vector<float> *> planes = aovs_.planes();
+        const float *value = payload.data();
+        for (int j = tile.y0_; j < tile.y1_; ++j)
         {
-            int start = t * rowsPerThread;
-            int end = (t == threadCount - 1) ? params_.imageHeight_ : start + rowsPerThread;
-            threads.emplace_back(&Renderer::renderRows, this, start, end, std::ref(world), lightSource);
+            for (int i = tile.x0_; i < tile.x1_; ++i)
+            {
+                size_t pixel = static_cast<size_t>(j) * params_.imageWidth_ + i;
+                frameBuffer_[pixel] = Color3(value[0], value[1], value[2]);
+                sampleCounts_[pixel] = static_cast<int>(value[3]);
+                sampleSums_[pixel] = frameBuffer_[pixel] * value[3];
+                value += 4;
+                for (std::vector<float> *plane : planes)
+                    (*plane)[pixel] = *value++;
+            }
         }
+    }
+#endif
+
+    // Samples pixel (i, j) until the standard error of its mean luminance drops below the threshold.
+    // Flat pixels stop at the minimum; the budget they leave goes to noisy pixels, up to the maximum.
+    int sampleAdaptively(int i, int j, const Object &world, const LightSampler &lights, Sampler &sampler, Color3 &pixelColor,
+                         PixelAOVs *aovs)
+    {
+        int minimumSamples = std::max(params_.minimumSamplesPerPixel_, 2);
+        int maximumSamples = std::max(params_.maximumSamplesPerPixel_, minimumSamples);
+        double mean = 0.0;
+        double squaredDeviations = 0.0; // Welford running sum of squared deviations from the mean
+
+        int samples = 0;
+        while (samples < maximumSamples)
+        {
+            Color3 sample = traceSample(i, j, samples, world, lights, sampler, aovs);
+            pixelColor += sample;
+            ++samples;
+
+            double luminance = sample.luminance();
+            double delta = luminance - mean;
+            mean += delta / samples;
+            squaredDeviations += delta * (luminance - mean);
 
-        for (auto &thread : threads)
-            thread.join();
+            if (samples >= minimumSamples)
+            {
+                double standardError = sqrt(squaredDeviations / (samples - 1) / samples);
+                if (standardError <= params_.adaptiveErrorThreshold_ * std::max(mean, 0.05)) // Dark pixels are judged against a floor
+                    break;
+            }
+        }
+        return samples;
     }
 
-    void writeOutput(const std::string &filename)
+    // Progressive: every pass adds samplesPerPass() samples to every pixel, so the buffers always hold a
+    // complete image. With a checkpoint, finished passes are saved and a restarted render carries on after them.
+    void renderMultithread(const Object &world, const LightSampler &lights)
     {
-        std::ofstream outFile(filename);
-        outFile << "P3\n"
-                << params_.imageWidth_ << " " << params_.imageHeight_ << "\n255\n";
-        for (int j = 0; j < params_.imageHeight_; ++j)
+        tiles_ = makeTiles(params_.imageWidth_, params_.imageHeight_, params_.tileSize_);
+        clearAccumulation();
+        int passSamples = samplesPerPass();
+        int passCount = (params_.samplesPerPixel_ + passSamples - 1) / passSamples;
+        int resumeSample = params_.checkpointFileName_.empty() ? 0 : resumeFromCheckpoint(passSamples);
+        int firstPass = resumeSample >= params_.samplesPerPixel_ ? passCount : resumeSample / passSamples;
+
+        tilesCompleted_ = static_cast<int>(firstPass * tiles_.size());
+        progressTotal_ = std::max<size_t>(passCount * tiles_.size(), 1);
+        lastReportedPercent_ = -1;
+        statistics_.start(threadPool_.threadCount());
+        auto lastCheckpoint = std::chrono::steady_clock::now();
+        for (int pass = firstPass; pass < passCount; ++pass)
         {
-            for (int i = 0; i < params_.imageWidth_; ++i)
+            int firstSample = pass * passSamples;
+            int endSample = std::min(firstSample + passSamples, params_.samplesPerPixel_);
+            threadPool_.run(tiles_.size(), [&](size_t tileIndex, int worker)
+                            {
+                                renderTile(tileIndex, worker, world, lights, firstSample, endSample);
+                                updateProgressBar(++tilesCompleted_); });
+            bool lastPass = pass + 1 == passCount;
+            if (!params_.checkpointFileName_.empty() &&
+                (lastPass || std::chrono::duration<double>(std::chrono::steady_clock::now() - lastCheckpoint).count() >=
+                                 params_.checkpointIntervalSeconds_))
             {
-                const Color3 &color = frameBuffer_[j * params_.imageWidth_ + i];
-                outFile << color.r() << ' ' << color.g() << ' ' << color.b() << '\n';
+                writeCheckpoint(pass + 1, endSample);
+                lastCheckpoint = std::chrono::steady_clock::now();
             }
         }
-        outFile.close();
+        std::cout << "\n";
+    }
+
+    // Each tile is written to the output file as soon as it is done, from a per-thread scratch tile, so memory
+    // is bounded by the threads rather than the image size
+    void renderStreamed(const Object &world, const LightSampler &lights)
+    {
+        std::string fileName = outputName(params_.fileName_);
+        StreamingImageFile output(fileName, params_.imageWidth_, params_.imageHeight_);
+        tiles_ = makeTiles(params_.imageWidth_, params_.imageHeight_, params_.tileSize_);
+        tilesCompleted_ = 0;
+        progressTotal_ = std::max<size_t>(tiles_.size(), 1);
+        lastReportedPercent_ = -1;
+        statistics_.start(threadPool_.threadCount());
+        std::vector<std::vector<float>> scratch(threadPool_.threadCount());
+        threadPool_.run(tiles_.size(), [&](size_t tileIndex, int worker)
+                        {
+                            std::vector<float> &pixels = scratch[worker];
+                            const Tile &tile = tiles_[tileIndex];
+                            pixels.resize(static_cast<size_t>(tile.pixelCount()) * 3);
+                            renderTile(tileIndex, worker, world, lights, 0, params_.samplesPerPixel_, pixels.data());
+                            output.writeTile(tile.x0_, tile.y0_, tile.width(), tile.height(), pixels);
+                            updateProgressBar(++tilesCompleted_); });
+        output.close();
+        std::cout << "\nStreamed " << tiles_.size() << " tiles into " << fileName << "\n";
+    }
+
+    static size_t bufferedPixels(const RendererParameters &params)
+    {
+        return params.streamOutput_ ? 0 : static_cast<size_t>(params.imageWidth_) * params.imageHeight_;
+    }
+
+    // Adaptive sampling decides per pixel how many samples to take, so it always renders in one pass
+    int samplesPerPass() const
+    {
+        if (params_.adaptiveSampling_)
+            return std::max(params_.samplesPerPixel_, 1);
+        int passSamples = params_.samplesPerPass_ > 0 ? params_.samplesPerPass_ : (params_.checkpointFileName_.empty() ? params_.samplesPerPixel_ : 16);
+        return std::max(passSamples, 1);
+    }
+
+    void clearAccumulation()
+    {
+        std::fill(sampleSums_.begin(), sampleSums_.end(), Color3(0, 0, 0));
+        std::fill(sampleCounts_.begin(), sampleCounts_.end(), 0);
+    }
+
+    CheckpointHeader checkpointHeader() const
+    {
+        CheckpointHeader header{};
+        header.width_ = static_cast<uint32_t>(params_.imageWidth_);
+        header.height_ = static_cast<uint32_t>(params_.imageHeight_);
+        header.samplesPerPixel_ = static_cast<uint32_t>(params_.samplesPerPixel_);
+        header.samplerType_ = static_cast<uint32_t>(params_.samplerType_);
+        header.aovPasses_ = aovs_.passes_;
+        header.randomSeed_ = params_.randomSeed_;
+        header.mergedRuns_ = 1;
+        return header;
+    }
+
+    void writeCheckpoint(int passesDone, int nextSample)
+    {
+        CheckpointHeader header = checkpointHeader();
+        header.passIndex_ = static_cast<uint32_t>(passesDone);
+        header.nextSample_ = static_cast<uint32_t>(nextSample);
+        std::string fileName = outputName(params_.checkpointFileName_);
+        RenderCheckpoint::write(fileName, header, sampleSums_, sampleCounts_, aovs_);
+        std::cout << "\nCheckpoint after pass " << passesDone << " (" << nextSample << " samples per pixel) saved to " << fileName << "\n";
+    }
+
+    // Loads the checkpoint, if there is one, and returns the sample index to continue from. One written for another
+    // image, sampler, seed, sample count or set of passes is an error rather than something to overwrite.
+    int resumeFromCheckpoint(int passSamples)
+    {
+        std::string fileName = outputName(params_.checkpointFileName_);
+        if (!std::filesystem::exists(fileName))
+            return 0;
+        RenderCheckpoint checkpoint = RenderCheckpoint::read(fileName);
+        CheckpointHeader expected = checkpointHeader();
+        const CheckpointHeader &found = checkpoint.header_;
+        if (found.width_ != expected.width_ || found.height_ != expected.height_ || found.samplesPerPixel_ != expected.samplesPerPixel_ ||
+            found.samplerType_ != expected.samplerType_ || found.aovPasses_ != expected.aovPasses_ ||
+            found.randomSeed_ != expected.randomSeed_ || found.mergedRuns_ != 1 ||
+            (found.nextSample_ < found.samplesPerPixel_ && found.nextSample_ % passSamples != 0))
+            throw std::runtime_error(fileName + ": checkpoint of a different render; delete it to start over");
+
+        for (size_t p = 0; p < sampleSums_.size(); ++p)
+        {
+            sampleSums_[p] = Color3(checkpoint.sums_[3 * p], checkpoint.sums_[3 * p + 1], checkpoint.sums_[3 * p + 2]);
+            sampleCounts_[p] = checkpoint.counts_[p];
+            frameBuffer_[p] = sampleCounts_[p] > 0 ? sampleSums_[p] * (1.0 / sampleCounts_[p]) : Color3(0, 0, 0);
+        }
+        std::vector<std::vector<float> *> planes = aovs_.planes();
+        std::vector<std::vector<float> *> savedPlanes = checkpoint.aovs_.planes();
+        for (size_t c = 0; c < planes.size(); ++c)
+            planes[c]->swap(*savedPlanes[c]);
+        std::cout << "Resumed from " << fileName << " after " << found.nextSample_ << " samples per pixel\n";
+        return static_cast<int>(found.nextSample_);
+    }
+
+    // Statistics, then denoising and every output file of the frame in the buffers
+    void finishFrame(double renderSeconds)
+    {
+        reportStatistics(renderSeconds);
+        if (params_.denoise_)
+            denoiseFrameBuffer();
+        writeOutput(outputName(params_.fileName_));
+        if (params_.aovPasses_)
+            writeAOVs(outputName(params_.aovFileName_));
+        if (params_.adaptiveSampling_)
+        {
+            reportSampleCounts();
+            if (!params_.sampleHeatmapFileName_.empty())
+                writeSampleHeatmap(outputName(params_.sampleHeatmapFileName_));
+        }
+    }
+
+    // Ray counters and the tile trace, when the build records them; streamed renders end here
+    void reportStatistics(double renderSeconds)
+    {
+        if constexpr (statisticsEnabled)
+        {
+            statistics_.report(renderSeconds);
+            if (!params_.traceFileName_.empty())
+                statistics_.writeTrace(outputName(params_.traceFileName_));
+        }
+        else if (!params_.traceFileName_.empty())
+        {
+            std::cerr << "No tile trace written: build with -DRAYTRACER_STATISTICS=ON to record one\n";
+        }
+    }
+
+    // Runs over the same tiles and threads as the render
+    void denoiseFrameBuffer()
+    {
+        auto denoiseStart = std::chrono::steady_clock::now();
+        Denoiser denoiser(params_.denoiser_);
+        denoiser.denoise(frameBuffer_, aovs_, tiles_, threadPool_);
+        double denoiseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - denoiseStart).count();
+        std::cout << "Denoised in " << denoiseSeconds * 1e3 << " ms (" << params_.denoiser_.iterations_ << " passes)\n";
+    }
+
+    std::string outputName(const std::string &fileName) const
+    {
+        if (frame_ < 0)
+            return fileName;
+        std::string number = std::to_string(frame_);
+        number.insert(0, number.size() < 4 ? 4 - number.size() : 0, '0');
+        size_t dot = fileName.find_last_of('.');
+        size_t slash = fileName.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            return fileName + "_" + number;
+        return fileName.substr(0, dot) + "_" + number + fileName.substr(dot);
+    }
+
+    void reportThreadBalance() const
+    {
+        const std::vector<double> &busy = threadPool_.busySeconds();
+        double longest = *std::max_element(busy.begin(), busy.end());
+        std::streamsize precision = std::cout.precision();
+        std::cout << "Per-thread busy time:\n";
+        for (size_t t = 0; t < busy.size(); ++t)
+        {
+            std::cout << "  thread " << t << ": " << std::fixed << std::setprecision(3) << busy[t] << " s ("
+                      << std::setprecision(1) << (longest > 0.0 ? 100.0 * busy[t] / longest : 100.0) << "% of busiest)\n";
+        }
+        std::cout << std::defaultfloat << std::setprecision(precision);
+    }
+
+    void reportSampleCounts() const
+    {
+        long long total = 0;
+        for (int count : sampleCounts_)
+            total += count;
+        double average = static_cast<double>(total) / sampleCounts_.size();
+        std::cout << "Adaptive sampling: " << average << " samples per pixel on average ("
+                  << params_.minimumSamplesPerPixel_ << " min, " << params_.maximumSamplesPerPixel_ << " max)\n";
+    }
+
+    // Blue where the minimum was enough, through green, to red where the maximum was reached
+    void writeSampleHeatmap(const std::string &filename)
+    {
+        Image heatmap{params_.imageWidth_, params_.imageHeight_, {}, false};
+        heatmap.pixels_.reserve(sampleCounts_.size() * 3);
+        int range = std::max(params_.maximumSamplesPerPixel_ - params_.minimumSamplesPerPixel_, 1);
+        for (int count : sampleCounts_)
+        {
+            float t = std::clamp(static_cast<float>(count - params_.minimumSamplesPerPixel_) / range, 0.0f, 1.0f);
+            if (t < 0.5f)
+                heatmap.pixels_.insert(heatmap.pixels_.end(), {0.0f, 2.0f * t, 1.0f - 2.0f * t});
+            else
+                heatmap.pixels_.insert(heatmap.pixels_.end(), {2.0f * t - 1.0f, 2.0f - 2.0f * t, 0.0f});
+        }
+        imageWriter_.writeAsync(std::move(heatmap), filename);
+    }
+
+    // Snapshots the frame buffer and encodes it in the background; the next render may start right away
+    void writeOutput(const std::string &filename)
+    {
+        imageWriter_.writeAsync(Image{params_.imageWidth_, params_.imageHeight_, framePixels(), true}, filename);
+    }
+
+    // The (possibly denoised) image as R, G and B, followed by every selected pass
+    void writeAOVs(const std::string &filename)
+    {
+        LayeredImage layers = ImageWriter::toLayers(Image{params_.imageWidth_, params_.imageHeight_, framePixels(), true});
+        aovs_.addLayers(layers);
+        imageWriter_.writeAsync(std::move(layers), filename);
+    }
+
+    std::vector<float> framePixels() const
+    {
+        std::vector<float> pixels(frameBuffer_.size() * 3);
+        for (size_t p = 0; p < frameBuffer_.size(); ++p)
+        {
+            pixels[3 * p] = static_cast<float>(frameBuffer_[p].red());
+            pixels[3 * p + 1] = static_cast<float>(frameBuffer_[p].green());
+            pixels[3 * p + 2] = static_cast<float>(frameBuffer_[p].blue());
+        }
+        return pixels;
     }
 };
 
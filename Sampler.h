@@ -0,0 +1,220 @@
+#ifndef RAYTRACER_SAMPLER_H
+#define RAYTRACER_SAMPLER_H
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include "HelperFunctions.h"
+
+struct Sample2D
+{
+    double u_;
+    double v_;
+};
+
+enum class SamplerType
+{
+    Independent, // Uniform random numbers
+    Stratified,  // One jittered sample per stratum, strata visited in a random order
+    Sobol        // Owen-scrambled Sobol (0,2)-sequence, shuffled per dimension pair
+};
+
+// Produces the sample values used for one camera sample of one pixel.
+// Every dimension requested with get1D()/get2D() gets its own decorrelated sequence.
+class Sampler
+{
+public:
+    explicit Sampler(uint64_t seed) : seed_{seed} {}
+    virtual ~Sampler() = default;
+
+    // Starts sample sampleIndex of pixel (x, y). The thread's random generator is reseeded too,
+    // so everything drawn with randomDouble() while tracing this sample is reproducible.
+    void startPixelSample(int x, int y, int sampleIndex)
+    {
+        pixelSeed_ = mixBits(seed_ ^ mixBits((static_cast<uint64_t>(static_cast<uint32_t>(y)) << 32) | static_cast<uint32_t>(x)));
+        sampleIndex_ = static_cast<uint32_t>(sampleIndex);
+        dimension_ = 0;
+        seedRandom(pixelSeed_, sampleIndex_);
+    }
+
+    virtual double get1D() = 0;
+    virtual Sample2D get2D() = 0;
+
+protected:
+    uint64_t seed_;
+    uint64_t pixelSeed_{0};
+    uint32_t sampleIndex_{0};
+    uint32_t dimension_{0};
+
+    // Seed that differs per pixel and per dimension, but not per sample
+    uint32_t dimensionSeed(uint32_t salt = 0) const
+    {
+        return static_cast<uint32_t>(mixBits(pixelSeed_ + 0x9e3779b97f4a7c15ULL * (dimension_ + 1) + salt));
+    }
+
+    static double toUnit(uint32_t bits)
+    {
+        return bits * 0x1p-32;
+    }
+
+    static uint32_t reverseBits(uint32_t v)
+    {
+        v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+        v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+        v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+        v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+        return (v >> 16) | (v << 16);
+    }
+
+    // Kensler's hash-based permutation of [0, length)
+    static uint32_t permuteIndex(uint32_t i, uint32_t length, uint32_t seed)
+    {
+        uint32_t mask = length - 1;
+        mask |= mask >> 1;
+        mask |= mask >> 2;
+        mask |= mask >> 4;
+        mask |= mask >> 8;
+        mask |= mask >> 16;
+        do
+        {
+            i ^= seed;
+            i *= 0xe170893du;
+            i ^= seed >> 16;
+            i ^= (i & mask) >> 4;
+            i ^= seed >> 8;
+            i *= 0x0929eb3fu;
+            i ^= seed >> 23;
+            i ^= (i & mask) >> 1;
+            i *= 1 | seed >> 27;
+            i *= 0x6935fa69u;
+            i ^= (i & mask) >> 11;
+            i *= 0x74dcb303u;
+            i ^= (i & mask) >> 2;
+            i *= 0x9e501cc3u;
+            i ^= (i & mask) >> 2;
+            i *= 0xc860a3dfu;
+            i &= mask;
+            i ^= i >> 5;
+        } while (i >= length);
+        return (i + seed) % length;
+    }
+};
+
+class IndependentSampler : public Sampler
+{
+public:
+    using Sampler::Sampler;
+
+    double get1D() override
+    {
+        ++dimension_;
+        return randomDouble0to1();
+    }
+
+    Sample2D get2D() override
+    {
+        ++dimension_;
+        return {randomDouble0to1(), randomDouble0to1()};
+    }
+};
+
+class StratifiedSampler : public Sampler
+{
+public:
+    StratifiedSampler(int samplesPerPixel, uint64_t seed) : Sampler(seed)
+    {
+        strata1D_ = static_cast<uint32_t>(std::max(samplesPerPixel, 1));
+        stratumColumns_ = std::max(1u, static_cast<uint32_t>(std::sqrt(static_cast<double>(strata1D_))));
+        stratumRows_ = (strata1D_ + stratumColumns_ - 1) / stratumColumns_;
+    }
+
+    double get1D() override
+    {
+        uint32_t stratum = permuteIndex(sampleIndex_ % strata1D_, strata1D_, dimensionSeed(sampleIndex_ / strata1D_));
+        ++dimension_;
+        return (stratum + randomDouble0to1()) / strata1D_;
+    }
+
+    Sample2D get2D() override
+    {
+        uint32_t cells = stratumColumns_ * stratumRows_;
+        uint32_t cell = permuteIndex(sampleIndex_ % cells, cells, dimensionSeed(sampleIndex_ / cells));
+        ++dimension_;
+        return {((cell % stratumColumns_) + randomDouble0to1()) / stratumColumns_,
+                ((cell / stratumColumns_) + randomDouble0to1()) / stratumRows_};
+    }
+
+private:
+    uint32_t strata1D_;
+    uint32_t stratumColumns_;
+    uint32_t stratumRows_;
+};
+
+// Burley, "Practical Hash-based Owen Scrambling" (2020): the first two Sobol dimensions,
+// with the sample index shuffled and the values Owen-scrambled by a different seed for every dimension
+class SobolSampler : public Sampler
+{
+public:
+    using Sampler::Sampler;
+
+    double get1D() override
+    {
+        uint32_t index = nestedUniformScramble(sampleIndex_, dimensionSeed(1));
+        double value = toUnit(nestedUniformScramble(reverseBits(index), dimensionSeed(2)));
+        ++dimension_;
+        return value;
+    }
+
+    Sample2D get2D() override
+    {
+        uint32_t index = nestedUniformScramble(sampleIndex_, dimensionSeed(1));
+        Sample2D sample{toUnit(nestedUniformScramble(reverseBits(index), dimensionSeed(2))),
+                        toUnit(nestedUniformScramble(sobolSecondDimension(index), dimensionSeed(3)))};
+        ++dimension_;
+        return sample;
+    }
+
+private:
+    // Second Sobol dimension (primitive polynomial x + 1); the first is the bit-reversed index
+    static uint32_t sobolSecondDimension(uint32_t index)
+    {
+        uint32_t result = 0;
+        for (uint32_t direction = 1u << 31; index != 0; index >>= 1, direction ^= direction >> 1)
+        {
+            if (index & 1u)
+                result ^= direction;
+        }
+        return result;
+    }
+
+    static uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed)
+    {
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return x;
+    }
+
+    static uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+    {
+        return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+    }
+};
+
+inline std::unique_ptr<Sampler> makeSampler(SamplerType type, int samplesPerPixel, uint64_t seed)
+{
+    switch (type)
+    {
+    case SamplerType::Independent:
+        return std::make_unique<IndependentSampler>(seed);
+    case SamplerType::Stratified:
+        return std::make_unique<StratifiedSampler>(samplesPerPixel, seed);
+    case SamplerType::Sobol:
+        break;
+    }
+    return std::make_unique<SobolSampler>(seed);
+}
+
+#endif // RAYTRACER_SAMPLER_H
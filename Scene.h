@@ -1,26 +1,48 @@
 #ifndef RAYTRACER_SCENE_H
 #define RAYTRACER_SCENE_H
 
+#include <stdexcept>
 #include "HelperFunctions.h"
 #include "Interval.h"
 #include "Ray.h"
 #include "Vector3.h"
 #include "Material.h"
 #include "HitRecord.h"
+#include "Statistics.h"
 #include "AABB.h"
 
 class Object
 {
 public:
-    virtual std::optional<HitRecord> rayHit(const Ray &ray, Interval rayInterval) const = 0;
+    // Closest hit inside the interval. On success hit is overwritten and true is returned; callers shrink
+    // the interval to hit.distance_ so later candidates must be closer.
+    virtual bool intersect(const Ray &ray, Interval rayInterval, PrimitiveHit &hit) const = 0;
+
+    // Surface data for a hit this primitive (or instance) recorded; aggregates never own a PrimitiveHit
+    virtual HitRecord surface(const Ray &, const PrimitiveHit &) const
+    {
+        throw std::logic_error("surface() called on an object that does not record hits");
+    }
+
+    std::optional<HitRecord> rayHit(const Ray &ray, Interval rayInterval) const
+    {
+        PrimitiveHit hit;
+        if (!intersect(ray, rayInterval, hit))
+            return std::nullopt;
+        return (hit.instance_ ? hit.instance_ : hit.primitive_)->surface(ray, hit);
+    }
+
+    // Any-hit query: true as soon as something blocks the ray inside the interval, without building a HitRecord
+    virtual bool occluded(const Ray &ray, Interval rayInterval) const = 0;
     virtual AABB boundingBox() const = 0;
+    virtual ~Object() = default;
 };
 
 class Sphere : public Object
 {
 public:
-    Sphere(Point3 centre, double radius, const Material *material) : centre_{centre}, radius_{radius}, material_{material} {}
-    std::optional<HitRecord> rayHit(const Ray &ray, Interval rayInterval) const override
+    Sphere(Point3 centre, double radius, MaterialId material) : centre_{centre}, radius_{radius}, material_{material} {}
+    bool intersect(const Ray &ray, Interval rayInterval, PrimitiveHit &hit) const override
     {
         Vector3 rayToCenter = ray.origin() - centre_;                                     // vector from ray origin to sphere center
         double sqr_ray = ray.direction().length_squared();                                // squared length of ray direction
@@ -32,7 +54,7 @@ public:
         // delta' = B'^2 - AC
         double discriminant = (dot_rayCenter_ray * dot_rayCenter_ray) - (sqr_ray * sqr_rayCenter_radius);
         if (discriminant < 0)
-            return std::nullopt; // no intersection
+            return false; // no intersection
 
         double sqrt_discriminant = sqrt(discriminant);
 
@@ -43,21 +65,43 @@ public:
             hitDistance = (-dot_rayCenter_ray + sqrt_discriminant) / sqr_ray;
             if (!rayInterval.surrounds(hitDistance))
             {
-                return std::nullopt; // no intersection within the ray interval
+                return false; // no intersection within the ray interval
             }
         }
 
-        Point3 hitPoint = ray.pointAlongRay(hitDistance);
+        hit.distance_ = hitDistance;
+        hit.primitive_ = this;
+        hit.instance_ = nullptr;
+        return true;
+    }
+    HitRecord surface(const Ray &ray, const PrimitiveHit &hit) const override
+    {
+        Point3 hitPoint = ray.pointAlongRay(hit.distance_);
         Vector3 normalAtHit = (hitPoint - centre_) / radius_; // normalized vector from sphere center to hit point
 
         HitRecord rec;
         rec.setHitPoint(hitPoint);
         rec.setSurfaceNormal(normalAtHit);
-        rec.setDistanceAlongRay(hitDistance);
+        rec.setDistanceAlongRay(hit.distance_);
         rec.setFrontFace(ray.direction(), normalAtHit); // front face if ray direction and normal are in opposite directions
-        rec.setSurfaceMaterial(material_);                      // Set the material of the sphere
+        rec.setMaterialId(material_);                      // Set the material of the sphere
         return rec;
     }
+    bool occluded(const Ray &ray, Interval rayInterval) const override
+    {
+        Vector3 rayToCenter = ray.origin() - centre_;
+        double sqr_ray = ray.direction().length_squared();
+        double dot_rayCenter_ray = rayToCenter.dot(ray.direction());
+        double sqr_rayCenter_radius = rayToCenter.length_squared() - (radius_ * radius_);
+
+        double discriminant = (dot_rayCenter_ray * dot_rayCenter_ray) - (sqr_ray * sqr_rayCenter_radius);
+        if (discriminant < 0)
+            return false;
+
+        double sqrt_discriminant = sqrt(discriminant);
+        return rayInterval.surrounds((-dot_rayCenter_ray - sqrt_discriminant) / sqr_ray) ||
+               rayInterval.surrounds((-dot_rayCenter_ray + sqrt_discriminant) / sqr_ray);
+    }
     AABB boundingBox() const override
     {
         Point3 minPoint = centre_ - Vector3(radius_, radius_, radius_);
@@ -65,45 +109,64 @@ public:
         return AABB(minPoint, maxPoint);
     }
     Point3 centre() const { return centre_; }
-    const Material *material() const { return material_; }
+    double radius() const { return radius_; }
+    MaterialId material() const { return material_; }
 
     // Generate a random point on the surface of the sphere
     Point3 randomPointOnSurface() const {
-        Vector3 randomDirection = Vector3::randomUnitVector(); // Generate a random unit vector
-        return centre_ + (randomDirection * radius_); // Scale it by the radius and translate to the sphere's center
+        return pointOnSurface(randomDouble0to1(), randomDouble0to1());
+    }
+
+    // Map two uniform samples in [0, 1) to a uniformly distributed point on the surface
+    Point3 pointOnSurface(double u1, double u2) const {
+        return centre_ + (Vector3::unitVectorFromSamples(u1, u2) * radius_);
     }
 private:
     Point3 centre_{0.0, 0.0, -1.0};
     double radius_{0.5};
-    const Material *material_;
+    MaterialId material_;
 };
 
 class Plane : public Object
 {
 public:
-    Plane(Point3 centre, const Material *material) : centre_{centre}, material_{material} {}
-    std::optional<HitRecord> rayHit(const Ray &ray, Interval rayInterval) const override
+    Plane(Point3 centre, MaterialId material) : centre_{centre}, material_{material} {}
+    bool intersect(const Ray &ray, Interval rayInterval, PrimitiveHit &hit) const override
     {
         // Assume the plane normal is (0, 1, 0) (y-up), and centre_ is a point on the plane
         Vector3 planeNormal_{0.0, 1.0, 0.0}; // Plane normal
         double demoniator = planeNormal_.dot(ray.direction());
 
         if (fabs(demoniator) < 1e-8)
-            return std::nullopt; // Ray is parallel to the plane
+            return false; // Ray is parallel to the plane
         double distanceToPlane = planeNormal_.dot(centre_ - ray.origin()) / demoniator;
 
         if (!rayInterval.surrounds(distanceToPlane))
-            return std::nullopt; // No intersection within the ray interval
-        Point3 hitPoint = ray.pointAlongRay(distanceToPlane);
+            return false; // No intersection within the ray interval
+        hit.distance_ = distanceToPlane;
+        hit.primitive_ = this;
+        hit.instance_ = nullptr;
+        return true;
+    }
+    HitRecord surface(const Ray &ray, const PrimitiveHit &hit) const override
+    {
+        Vector3 planeNormal_{0.0, 1.0, 0.0}; // Plane normal
 
         HitRecord rec;
-        rec.setHitPoint(hitPoint);
+        rec.setHitPoint(ray.pointAlongRay(hit.distance_));
         rec.setSurfaceNormal(planeNormal_);
-        rec.setDistanceAlongRay(distanceToPlane);
+        rec.setDistanceAlongRay(hit.distance_);
         rec.setFrontFace(ray.direction(), planeNormal_); // front face if ray direction and normal are in opposite directions
-        rec.setSurfaceMaterial(material_);                       // Set the material of the plane
+        rec.setMaterialId(material_);                       // Set the material of the plane
         return rec;
     }
+    bool occluded(const Ray &ray, Interval rayInterval) const override
+    {
+        double demoniator = ray.direction().y(); // Plane normal is (0, 1, 0)
+        if (fabs(demoniator) < 1e-8)
+            return false;
+        return rayInterval.surrounds((centre_.y() - ray.origin().y()) / demoniator);
+    }
     AABB boundingBox() const override
     {
         double extent = 1e5; // Large extent for the plane
@@ -117,7 +180,7 @@ public:
 
 private:
     Point3 centre_{0.0, -0.5, 0.0}; // A point on the plane
-    const Material *material_;
+    MaterialId material_;
 };
 
 class Scene : public Object
@@ -140,23 +203,32 @@ public:
         objects_.clear();
     }
 
-    std::optional<HitRecord> rayHit(const Ray &ray, Interval rayInterval) const override
+    bool intersect(const Ray &ray, Interval rayInterval, PrimitiveHit &hit) const override
     {
-        HitRecord tempHitRecord;
         bool hitAnything = false;
         double closestSoFar = rayInterval.max();
 
         for (const auto &o : objects_)
         {
-            if (auto tempHit = o->rayHit(ray, Interval(rayInterval.min(), closestSoFar)))
+            RAYTRACER_COUNT(primitiveTests_, 1);
+            if (o->intersect(ray, Interval(rayInterval.min(), closestSoFar), hit))
             {
                 hitAnything = true;
-                closestSoFar = tempHit->distanceAlongRay();
-                tempHitRecord = *tempHit;
+                closestSoFar = hit.distance_;
             }
         }
 
-        return hitAnything ? std::optional<HitRecord>{tempHitRecord} : std::nullopt;
+        return hitAnything;
+    }
+    bool occluded(const Ray &ray, Interval rayInterval) const override
+    {
+        for (const auto &o : objects_)
+        {
+            RAYTRACER_COUNT(primitiveTests_, 1);
+            if (o->occluded(ray, rayInterval))
+                return true;
+        }
+        return false;
     }
     AABB boundingBox() const override
     {
@@ -0,0 +1,613 @@
+#ifndef RAYTRACER_SCENE_LOADER_H
+#define RAYTRACER_SCENE_LOADER_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Animation.h"
+#include "Arena.h"
+#include "BVHCache.h"
+#include "Camera.h"
+#include "Instance.h"
+#include "MaterialFactory.h"
+#include "MeshLoader.h"
+#include "Renderer.h"
+
+// Everything a render needs, as described by a scene file. Objects point into the storage members,
+// so a SceneDescription is neither copied nor moved.
+struct SceneDescription
+{
+    std::unique_ptr<BVHCache> cache_; // Cached BVH nodes are used in place, so the mapping stays open
+    Arena arena_;
+    std::vector<std::unique_ptr<TriangleMesh>> meshes_;
+    std::vector<std::unique_ptr<WideBVH<preferredBVHWidth>>> meshBVHs_; // One per mesh, shared by its instances
+
+    Camera camera_;
+    RendererParameters renderParameters_;
+    MaterialTable materials_;
+    std::vector<Object *> objects_; // Spheres, planes and mesh instances, in file order
+    std::unique_ptr<WideBVH<preferredBVHWidth>> world_;
+    bool loadedFromCache_{false};
+    Animation animation_; // Empty unless the file has a frames line
+
+    SceneDescription() = default;
+    SceneDescription(const SceneDescription &) = delete;
+    SceneDescription &operator=(const SceneDescription &) = delete;
+};
+
+// Line-based text scene format; '#' starts a comment and file paths are relative to the scene file.
+//
+//   image <width> <height>                   samples <n>        depth <n>         lightsamples <n>
+//   sampler independent|stratified|sobol     seed <n>           threads <n>       tilesize <n>
+//   adaptive <minimum> <maximum> <error>     output <file>      trace <file>
+//   denoise [passes]                         aov <file> <pass>...
+//   progressive <samples per pass>           checkpoint <file> [seconds between saves]
+//   stream                                   (tiles go straight into the .ppm or .pfm output as they finish)
+//   camera <x y z> <image plane centre x y z>
+//   material <name> diffuse|reflective|emissive <r g b>
+//   material <name> glossy <r g b> <glossiness>
+//   material <name> checker <r g b> <r g b> <scale>
+//   material <name> dielectric <refractive index>
+//   sphere <x y z> <radius> <material>
+//   plane <height> <material>                 (horizontal, facing +y)
+//   mesh <name> <file .obj or .ply> <material> [fit <x y z> <size>]
+//   instance <mesh> [translate <x y z>] [rotate <axis x y z> <degrees>] [scale <s> | scale <x y z>]
+//   frames <count>
+//   key <instance number> <frame> [translate <x y z>] [rotate <axis x y z> <degrees>] [scale <s> | scale <x y z>]
+//   camerakey <frame> <x y z> <image plane centre x y z>
+//
+// Instance transforms compose like the Transform product as written: the last one is applied first.
+// Keys are always translate * rotate * scale, whatever order they are written in; instances are numbered
+// from 0 in file order. With frames, every frame is rendered to <output>_<frame number>.<extension>.
+// Built BVHs and mesh data are cached next to the scene file (<scene>.bvhcache) and reused while the
+// cache is newer than the scene and every mesh file.
+namespace SceneLoader
+{
+    namespace detail
+    {
+        struct MeshEntry
+        {
+            std::string name_;
+            std::string path_;
+            MaterialId material_;
+            bool fit_{false};
+            Point3 fitCentre_{0, 0, 0};
+            double fitSize_{1.0};
+        };
+
+        struct InstanceEntry
+        {
+            size_t mesh_;
+            Transform transform_;
+            size_t objectIndex_; // Slot reserved in objects_, so instances keep their place in file order
+        };
+
+        // Whitespace-separated words of one line, read front to back
+        class LineReader
+        {
+        public:
+            LineReader(std::string_view line, const std::string &location) : line_{line}, location_{location} {}
+
+            bool atEnd()
+            {
+                skipSpaces();
+                return line_.empty();
+            }
+
+            std::string_view word()
+            {
+                skipSpaces();
+                if (line_.empty())
+                    fail("unexpected end of line");
+                size_t length = 0;
+                while (length < line_.size() && !isSpace(line_[length]))
+                    ++length;
+                std::string_view result = line_.substr(0, length);
+                line_.remove_prefix(length);
+                return result;
+            }
+
+            double number()
+            {
+                std::string_view text = word();
+                if (!text.empty() && text.front() == '+')
+                    text.remove_prefix(1); // from_chars does not accept a leading plus
+                double value = 0.0;
+                auto [next, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+                if (error != std::errc() || next != text.data() + text.size())
+                    fail("expected a number, got '" + std::string(text) + "'");
+                return value;
+            }
+
+            bool nextIsNumber()
+            {
+                if (atEnd())
+                    return false;
+                char first = line_.front();
+                return (first >= '0' && first <= '9') || first == '-' || first == '+' || first == '.';
+            }
+
+            int integer()
+            {
+                int64_t value = parseInteger<int64_t>("an integer");
+                if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max())
+                    fail("integer " + std::to_string(value) + " is out of range");
+                return static_cast<int>(value);
+            }
+
+            uint64_t unsignedInteger()
+            {
+                return parseInteger<uint64_t>("an unsigned integer");
+            }
+
+            Vector3 vector()
+            {
+                double x = number(), y = number();
+                return Vector3(x, y, number());
+            }
+
+            Color3 color()
+            {
+                double r = number(), g = number();
+                return Color3(r, g, number());
+            }
+
+            [[noreturn]] void fail(const std::string &message) const
+            {
+                throw std::runtime_error(location_ + ": " + message);
+            }
+
+        private:
+            std::string_view line_;
+            const std::string &location_;
+
+            static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+            template <typename T>
+            T parseInteger(const char *expected)
+            {
+                std::string_view text = word();
+                std::string_view digits = text;
+                if (!digits.empty() && digits.front() == '+')
+                    digits.remove_prefix(1); // from_chars does not accept a leading plus
+                T value = 0;
+                auto [next, error] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+                if (error == std::errc::result_out_of_range)
+                    fail("'" + std::string(text) + "' is out of range");
+                if (error != std::errc() || next != digits.data() + digits.size())
+                    fail(std::string("expected ") + expected + ", got '" + std::string(text) + "'");
+                return value;
+            }
+
+            void skipSpaces()
+            {
+                while (!line_.empty() && isSpace(line_.front()))
+                    line_.remove_prefix(1);
+            }
+        };
+
+        inline SamplerType parseSamplerType(LineReader &reader)
+        {
+            std::string_view name = reader.word();
+            if (name == "independent")
+                return SamplerType::Independent;
+            if (name == "stratified")
+                return SamplerType::Stratified;
+            if (name == "sobol")
+                return SamplerType::Sobol;
+            reader.fail("unknown sampler '" + std::string(name) + "'");
+        }
+
+        inline MaterialId parseMaterial(LineReader &reader, MaterialTable &materials)
+        {
+            std::string_view type = reader.word();
+            if (type == "diffuse")
+                return MaterialFactory::createDiffuse(materials, reader.color());
+            if (type == "reflective")
+                return MaterialFactory::createReflective(materials, reader.color());
+            if (type == "emissive")
+                return MaterialFactory::createEmissive(materials, reader.color());
+            if (type == "glossy")
+            {
+                Color3 color = reader.color();
+                return MaterialFactory::createGlossy(materials, color, reader.number());
+            }
+            if (type == "checker")
+            {
+                Color3 first = reader.color();
+                Color3 second = reader.color();
+                return MaterialFactory::createChecker(materials, first, second, reader.number());
+            }
+            if (type == "dielectric")
+                return MaterialFactory::createDielectric(materials, reader.number());
+            reader.fail("unknown material type '" + std::string(type) + "'");
+        }
+
+        inline Transform parseTransform(LineReader &reader)
+        {
+            Transform transform;
+            while (!reader.atEnd())
+            {
+                std::string_view operation = reader.word();
+                if (operation == "translate")
+                {
+                    transform = transform * Transform::translation(reader.vector());
+                }
+                else if (operation == "rotate")
+                {
+                    Vector3 axis = reader.vector();
+                    transform = transform * Transform::rotation(axis, reader.number());
+                }
+                else if (operation == "scale")
+                {
+                    double first = reader.number();
+                    if (reader.nextIsNumber())
+                    {
+                        double second = reader.number();
+                        transform = transform * Transform::scale(Vector3(first, second, reader.number()));
+                    }
+                    else
+                    {
+                        transform = transform * Transform::scale(first);
+                    }
+                }
+                else
+                {
+                    reader.fail("unknown transform '" + std::string(operation) + "'");
+                }
+            }
+            return transform;
+        }
+
+        inline TransformKey parseTransformKey(LineReader &reader)
+        {
+            TransformKey key;
+            key.frame_ = reader.number();
+            while (!reader.atEnd())
+            {
+                std::string_view operation = reader.word();
+                if (operation == "translate")
+                {
+                    key.translation_ = reader.vector();
+                }
+                else if (operation == "rotate")
+                {
+                    key.rotationAxis_ = reader.vector();
+                    key.rotationDegrees_ = reader.number();
+                }
+                else if (operation == "scale")
+                {
+                    double first = reader.number();
+                    if (reader.nextIsNumber())
+                    {
+                        double second = reader.number();
+                        key.scale_ = Vector3(first, second, reader.number());
+                    }
+                    else
+                    {
+                        key.scale_ = Vector3(first, first, first);
+                    }
+                }
+                else
+                {
+                    reader.fail("unknown transform '" + std::string(operation) + "'");
+                }
+            }
+            return key;
+        }
+
+        // Builds mesh data, mesh BVHs and the world BVH from scratch
+        inline void buildGeometry(SceneDescription &scene, const std::vector<MeshEntry> &meshes, const std::vector<InstanceEntry> &instances)
+        {
+            for (const MeshEntry &entry : meshes)
+            {
+                std::unique_ptr<TriangleMesh> mesh = MeshLoader::loadMesh(entry.path_, entry.material_);
+                if (entry.fit_)
+                    mesh->fitToBox(entry.fitCentre_, entry.fitSize_);
+                std::vector<Object *> triangles;
+                mesh->appendTriangles(triangles);
+                BVHNode tree(triangles, 0, triangles.size());
+                scene.meshBVHs_.push_back(std::make_unique<WideBVH<preferredBVHWidth>>(tree));
+                scene.meshes_.push_back(std::move(mesh));
+            }
+            for (const InstanceEntry &instance : instances)
+                scene.objects_[instance.objectIndex_] = scene.arena_.create<Instance>(scene.meshBVHs_[instance.mesh_].get(), instance.transform_);
+
+            std::vector<Object *> order = scene.objects_; // BVHNode reorders its input
+            BVHNode tree(order, 0, order.size());
+            scene.world_ = std::make_unique<WideBVH<preferredBVHWidth>>(tree);
+        }
+
+        // Per mesh: positions x/y/z, normals x/y/z, indices and its BVH; then the world BVH
+        inline void writeCache(const SceneDescription &scene, const std::string &cachePath)
+        {
+            BVHCacheWriter writer;
+            for (size_t m = 0; m < scene.meshes_.size(); ++m)
+            {
+                const TriangleMesh &mesh = *scene.meshes_[m];
+                for (int axis = 0; axis < 3; ++axis)
+                    writer.add(mesh.positions(axis));
+                for (int axis = 0; axis < 3; ++axis)
+                    writer.add(mesh.normals(axis));
+                writer.add(mesh.indices());
+
+                // Triangle order of the mesh itself, which is how readCache lists them again
+                std::vector<const Object *> triangles = scene.meshBVHs_[m]->primitives();
+                std::sort(triangles.begin(), triangles.end(), [](const Object *a, const Object *b)
+                          { return static_cast<const Triangle *>(a)->index() < static_cast<const Triangle *>(b)->index(); });
+                writer.addBVH(*scene.meshBVHs_[m], triangles);
+            }
+            writer.addBVH(*scene.world_, std::vector<const Object *>(scene.objects_.begin(), scene.objects_.end()));
+            writer.write<preferredBVHWidth>(cachePath);
+        }
+
+        inline void readCache(SceneDescription &scene, const std::vector<MeshEntry> &meshes, const std::vector<InstanceEntry> &instances,
+                              const std::string &cachePath)
+        {
+            scene.cache_ = BVHCache::open<preferredBVHWidth>(cachePath);
+            const BVHCache &cache = *scene.cache_;
+            size_t section = 0;
+            for (const MeshEntry &entry : meshes)
+            {
+                std::span<const float> positions[3], normals[3];
+                for (int axis = 0; axis < 3; ++axis)
+                    positions[axis] = cache.section<float>(section++);
+                for (int axis = 0; axis < 3; ++axis)
+                    normals[axis] = cache.section<float>(section++);
+                auto mesh = std::make_unique<TriangleMesh>(entry.material_);
+                mesh->assign(positions, normals, cache.section<uint32_t>(section++));
+
+                std::vector<Object *> triangles;
+                mesh->appendTriangles(triangles);
+                scene.meshBVHs_.push_back(cache.readBVH<preferredBVHWidth>(section, triangles));
+                scene.meshes_.push_back(std::move(mesh));
+            }
+            for (const InstanceEntry &instance : instances)
+                scene.objects_[instance.objectIndex_] = scene.arena_.create<Instance>(scene.meshBVHs_[instance.mesh_].get(), instance.transform_);
+
+            scene.world_ = cache.readBVH<preferredBVHWidth>(section, scene.objects_);
+            if (section != cache.sectionCount())
+                throw std::runtime_error("BVH cache: more sections than the scene needs");
+        }
+    }
+
+    // Parses the scene file and builds or loads its geometry. With useCache, a fresh cache replaces the
+    // mesh loading and BVH builds, and a stale or missing one is rewritten afterwards.
+    inline std::unique_ptr<SceneDescription> load(const std::string &path, bool useCache = true)
+    {
+        using namespace detail;
+        auto scene = std::make_unique<SceneDescription>();
+        std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+        std::unordered_map<std::string, MaterialId> materialIds;
+        std::unordered_map<std::string, size_t> meshIds;
+        std::vector<MeshEntry> meshes;
+        std::vector<InstanceEntry> instances;
+        Point3 cameraPosition(0, 0, 0), imagePlaneCentre(0, 0, -1);
+
+        MappedFile file(path);
+        std::string_view text(file.data(), file.size());
+        int lineNumber = 0;
+        while (!text.empty())
+        {
+            size_t newline = text.find('\n');
+            std::string_view line = text.substr(0, newline);
+            text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+            ++lineNumber;
+            line = line.substr(0, line.find('#'));
+
+            std::string location = path + ":" + std::to_string(lineNumber);
+            LineReader reader(line, location);
+            if (reader.atEnd())
+                continue;
+
+            auto materialNamed = [&](std::string_view name)
+            {
+                auto found = materialIds.find(std::string(name));
+                if (found == materialIds.end())
+                    reader.fail("unknown material '" + std::string(name) + "'");
+                return found->second;
+            };
+
+            std::string_view keyword = reader.word();
+            RendererParameters &params = scene->renderParameters_;
+            if (keyword == "image")
+            {
+                params.imageWidth_ = reader.integer();
+                params.imageHeight_ = reader.integer();
+                if (params.imageWidth_ <= 0 || params.imageHeight_ <= 0)
+                    reader.fail("image size must be positive");
+            }
+            else if (keyword == "samples")
+            {
+                params.samplesPerPixel_ = reader.integer();
+                if (params.samplesPerPixel_ <= 0)
+                    reader.fail("samples per pixel must be positive");
+            }
+            else if (keyword == "depth")
+            {
+                params.maximumRecursionDepth_ = reader.integer();
+                if (params.maximumRecursionDepth_ <= 0)
+                    reader.fail("depth must be positive");
+            }
+            else if (keyword == "lightsamples")
+                params.lightSamples_ = reader.integer();
+            else if (keyword == "sampler")
+                params.samplerType_ = parseSamplerType(reader);
+            else if (keyword == "seed")
+                params.randomSeed_ = reader.unsignedInteger();
+            else if (keyword == "threads")
+                params.threadCount_ = reader.integer();
+            else if (keyword == "tilesize")
+                params.tileSize_ = reader.integer();
+            else if (keyword == "adaptive")
+            {
+                params.adaptiveSampling_ = true;
+                params.minimumSamplesPerPixel_ = reader.integer();
+                params.maximumSamplesPerPixel_ = reader.integer();
+                params.adaptiveErrorThreshold_ = reader.number();
+            }
+            else if (keyword == "output")
+                params.fileName_ = std::string(reader.word());
+            else if (keyword == "trace")
+                params.traceFileName_ = std::string(reader.word());
+            else if (keyword == "aov")
+            {
+                params.aovFileName_ = std::string(reader.word());
+                do
+                {
+                    std::string_view name = reader.word();
+                    uint32_t pass = aovPassNamed(name);
+                    if (pass == 0)
+                        reader.fail("unknown AOV pass '" + std::string(name) + "'");
+                    params.aovPasses_ |= pass;
+                } while (!reader.atEnd());
+            }
+            else if (keyword == "stream")
+                params.streamOutput_ = true;
+            else if (keyword == "progressive")
+            {
+                params.samplesPerPass_ = reader.integer();
+                if (params.samplesPerPass_ <= 0)
+                    reader.fail("samples per pass must be positive");
+            }
+            else if (keyword == "checkpoint")
+            {
+                params.checkpointFileName_ = std::string(reader.word());
+                if (!reader.atEnd())
+                    params.checkpointIntervalSeconds_ = reader.number();
+            }
+            else if (keyword == "denoise")
+            {
+                params.denoise_ = true;
+                if (!reader.atEnd())
+                    params.denoiser_.iterations_ = reader.integer();
+            }
+            else if (keyword == "camera")
+            {
+                cameraPosition = reader.vector();
+                imagePlaneCentre = reader.vector();
+            }
+            else if (keyword == "material")
+            {
+                std::string name(reader.word());
+                if (materialIds.count(name))
+                    reader.fail("material '" + name + "' is defined twice");
+                materialIds[name] = parseMaterial(reader, scene->materials_);
+            }
+            else if (keyword == "sphere")
+            {
+                Point3 centre = reader.vector();
+                double radius = reader.number();
+                scene->objects_.push_back(scene->arena_.create<Sphere>(centre, radius, materialNamed(reader.word())));
+            }
+            else if (keyword == "plane")
+            {
+                double height = reader.number();
+                scene->objects_.push_back(scene->arena_.create<Plane>(Point3(0, height, 0), materialNamed(reader.word())));
+            }
+            else if (keyword == "mesh")
+            {
+                MeshEntry entry;
+                entry.name_ = std::string(reader.word());
+                entry.path_ = (directory / std::string(reader.word())).string();
+                entry.material_ = materialNamed(reader.word());
+                if (!reader.atEnd())
+                {
+                    if (reader.word() != "fit")
+                        reader.fail("expected 'fit' after the mesh material");
+                    entry.fit_ = true;
+                    entry.fitCentre_ = reader.vector();
+                    entry.fitSize_ = reader.number();
+                }
+                if (meshIds.count(entry.name_))
+                    reader.fail("mesh '" + entry.name_ + "' is defined twice");
+                meshIds[entry.name_] = meshes.size();
+                meshes.push_back(entry);
+            }
+            else if (keyword == "instance")
+            {
+                std::string name(reader.word());
+                auto found = meshIds.find(name);
+                if (found == meshIds.end())
+                    reader.fail("unknown mesh '" + name + "'");
+                instances.push_back({found->second, parseTransform(reader), scene->objects_.size()});
+                scene->objects_.push_back(nullptr); // Filled in once the mesh BVH exists
+            }
+            else if (keyword == "frames")
+            {
+                scene->animation_.frameCount_ = reader.integer();
+                if (scene->animation_.frameCount_ <= 0)
+                    reader.fail("frame count must be positive");
+            }
+            else if (keyword == "key")
+            {
+                int instance = reader.integer();
+                if (instance < 0 || instance >= static_cast<int>(instances.size()))
+                    reader.fail("no instance " + std::to_string(instance) + " defined above");
+                scene->animation_.addKey(instances[instance].objectIndex_, parseTransformKey(reader));
+            }
+            else if (keyword == "camerakey")
+            {
+                CameraKey key;
+                key.frame_ = reader.number();
+                key.position_ = reader.vector();
+                key.imagePlaneCentre_ = reader.vector();
+                scene->animation_.addCameraKey(key);
+            }
+            else
+            {
+                reader.fail("unknown keyword '" + std::string(keyword) + "'");
+            }
+            if (!reader.atEnd())
+                reader.fail("unexpected text after the " + std::string(keyword) + " line");
+        }
+
+        if (scene->objects_.empty())
+            throw std::runtime_error(path + ": scene has no objects");
+        scene->camera_ = Camera(cameraPosition, imagePlaneCentre, scene->renderParameters_.imageHeight_,
+                                static_cast<double>(scene->renderParameters_.imageWidth_) / scene->renderParameters_.imageHeight_);
+
+        std::string cachePath = path + ".bvhcache";
+        std::vector<std::string> inputs{path};
+        for (const MeshEntry &entry : meshes)
+            inputs.push_back(entry.path_);
+
+        if (useCache && BVHCache::isNewerThan(cachePath, inputs))
+        {
+            try
+            {
+                readCache(*scene, meshes, instances, cachePath);
+                scene->loadedFromCache_ = true;
+                return scene;
+            }
+            catch (const std::exception &error)
+            {
+                std::cerr << "Ignoring BVH cache: " << error.what() << "\n";
+                return load(path, false); // Start over, because objects may already point into the rejected cache
+            }
+        }
+
+        buildGeometry(*scene, meshes, instances);
+        try
+        {
+            writeCache(*scene, cachePath);
+        }
+        catch (const std::exception &error)
+        {
+            std::cerr << "Could not write BVH cache: " << error.what() << "\n";
+        }
+        return scene;
+    }
+}
+
+#endif // RAYTRACER_SCENE_LOADER_H
@@ -0,0 +1,214 @@
+#ifndef RAYTRACER_STATISTICS_H
+#define RAYTRACER_STATISTICS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Tile.h"
+
+// Hot-path counters for one thread. They are only collected when RAYTRACER_STATISTICS is defined
+// (CMake option of the same name); otherwise the RAYTRACER_COUNT macros expand to nothing.
+struct RenderCounters
+{
+    static constexpr int pathLengthBins = 32; // The last bin also holds every longer path
+
+    uint64_t cameraRays_{0};
+    uint64_t bounceRays_{0};
+    uint64_t shadowRays_{0};
+    uint64_t nodesVisited_{0};   // BVH nodes whose boxes were tested (one wide node counts once)
+    uint64_t primitiveTests_{0}; // Primitive intersect or occluded calls made from BVH leaves
+    uint64_t hits_{0};           // Camera and bounce rays that hit something
+    uint64_t paths_{0};
+    uint64_t pathSegments_{0}; // Sum of path lengths, in rays
+    uint64_t pathLengths_[pathLengthBins]{};
+
+    uint64_t rays() const { return cameraRays_ + bounceRays_ + shadowRays_; }
+
+    void recordPath(int length)
+    {
+        ++paths_;
+        pathSegments_ += length;
+        ++pathLengths_[std::clamp(length, 0, pathLengthBins - 1)];
+    }
+
+    void add(const RenderCounters &other)
+    {
+        cameraRays_ += other.cameraRays_;
+        bounceRays_ += other.bounceRays_;
+        shadowRays_ += other.shadowRays_;
+        nodesVisited_ += other.nodesVisited_;
+        primitiveTests_ += other.primitiveTests_;
+        hits_ += other.hits_;
+        paths_ += other.paths_;
+        pathSegments_ += other.pathSegments_;
+        for (int i = 0; i < pathLengthBins; ++i)
+            pathLengths_[i] += other.pathLengths_[i];
+    }
+};
+
+#if defined(RAYTRACER_STATISTICS)
+inline constexpr bool statisticsEnabled = true;
+inline thread_local RenderCounters threadCounters; // Folded into the worker's slot after every tile
+#define RAYTRACER_COUNT(counter, amount) (threadCounters.counter += (amount))
+#define RAYTRACER_COUNT_PATH(length) threadCounters.recordPath(length)
+#else
+inline constexpr bool statisticsEnabled = false;
+#define RAYTRACER_COUNT(counter, amount) ((void)0)
+#define RAYTRACER_COUNT_PATH(length) ((void)0)
+#endif
+
+// One rendered tile on the timeline
+struct TileEvent
+{
+    int tileIndex_;
+    int worker_;
+    Tile tile_;
+    double startMicroseconds_; // Since the start of the render
+    double durationMicroseconds_;
+    uint64_t rays_;
+};
+
+// Per-worker counters and tile timings. Each worker only touches its own cache-line-aligned slot,
+// so nothing is shared until merged() and the reports run after the render.
+class RenderStatistics
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void start(int workerCount)
+    {
+        slots_.assign(workerCount, WorkerSlot());
+        renderStart_ = Clock::now();
+    }
+
+    Clock::time_point beginTile() const
+    {
+        if constexpr (statisticsEnabled)
+            return Clock::now();
+        return {};
+    }
+
+    // Called by the worker that rendered the tile
+    void endTile([[maybe_unused]] int worker, [[maybe_unused]] int tileIndex, [[maybe_unused]] const Tile &tile,
+                 [[maybe_unused]] Clock::time_point tileStart)
+    {
+#if defined(RAYTRACER_STATISTICS)
+        Clock::time_point tileEnd = Clock::now();
+        WorkerSlot &slot = slots_[worker];
+        slot.tiles_.push_back({tileIndex, worker, tile,
+                               std::chrono::duration<double, std::micro>(tileStart - renderStart_).count(),
+                               std::chrono::duration<double, std::micro>(tileEnd - tileStart).count(),
+                               threadCounters.rays()});
+        slot.counters_.add(threadCounters);
+        threadCounters = RenderCounters();
+#endif
+    }
+
+    RenderCounters merged() const
+    {
+        RenderCounters total;
+        for (const WorkerSlot &slot : slots_)
+            total.add(slot.counters_);
+        return total;
+    }
+
+    void report(double renderSeconds) const
+    {
+        RenderCounters total = merged();
+        uint64_t rays = total.rays();
+        uint64_t closestHitRays = total.cameraRays_ + total.bounceRays_;
+        std::streamsize precision = std::cout.precision();
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << "Render statistics:\n";
+        std::cout << "  rays: " << total.cameraRays_ << " camera, " << total.bounceRays_ << " bounce, " << total.shadowRays_
+                  << " shadow (" << (renderSeconds > 0.0 ? rays / renderSeconds * 1e-6 : 0.0) << " Mrays/s)\n";
+        if (rays > 0)
+            std::cout << "  per ray: " << static_cast<double>(total.nodesVisited_) / rays << " BVH nodes, "
+                      << static_cast<double>(total.primitiveTests_) / rays << " primitive tests\n";
+        if (closestHitRays > 0)
+            std::cout << "  hits: " << 100.0 * total.hits_ / closestHitRays << "% of camera and bounce rays\n";
+        if (total.paths_ > 0)
+        {
+            int longest = 0;
+            for (int i = 0; i < RenderCounters::pathLengthBins; ++i)
+                if (total.pathLengths_[i] > 0)
+                    longest = i;
+            std::cout << "  paths: " << total.paths_ << ", " << static_cast<double>(total.pathSegments_) / total.paths_
+                      << " rays on average, longest " << longest << (longest == RenderCounters::pathLengthBins - 1 ? "+" : "") << "\n";
+        }
+
+        std::vector<TileEvent> tiles = tileEvents();
+        if (!tiles.empty())
+        {
+            double sum = 0.0;
+            const TileEvent *slowest = &tiles.front();
+            for (const TileEvent &event : tiles)
+            {
+                sum += event.durationMicroseconds_;
+                if (event.durationMicroseconds_ > slowest->durationMicroseconds_)
+                    slowest = &event;
+            }
+            std::cout << "  tiles: " << tiles.size() << ", " << sum / tiles.size() * 1e-3 << " ms on average, slowest "
+                      << slowest->durationMicroseconds_ * 1e-3 << " ms (tile " << slowest->tileIndex_ << " at "
+                      << slowest->tile_.x0_ << ", " << slowest->tile_.y0_ << ")\n";
+        }
+        std::cout << std::defaultfloat << std::setprecision(precision);
+    }
+
+    // Chrome trace event format: open in chrome://tracing or ui.perfetto.dev, one track per worker
+    void writeTrace(const std::string &fileName) const
+    {
+        std::ofstream out(fileName);
+        if (!out)
+            throw std::runtime_error("cannot open " + fileName + " for writing");
+        out << std::fixed << std::setprecision(3);
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+        const char *separator = "\n";
+        for (size_t worker = 0; worker < slots_.size(); ++worker)
+        {
+            out << separator << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << worker
+                << ", \"args\": {\"name\": \"worker " << worker << "\"}}";
+            separator = ",\n";
+        }
+        for (const TileEvent &event : tileEvents())
+        {
+            out << separator << "{\"name\": \"tile " << event.tileIndex_ << "\", \"cat\": \"tile\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.worker_
+                << ", \"ts\": " << event.startMicroseconds_ << ", \"dur\": " << event.durationMicroseconds_
+                << ", \"args\": {\"x0\": " << event.tile_.x0_ << ", \"y0\": " << event.tile_.y0_ << ", \"x1\": " << event.tile_.x1_
+                << ", \"y1\": " << event.tile_.y1_ << ", \"rays\": " << event.rays_ << "}}";
+            separator = ",\n";
+        }
+        out << "\n]}\n";
+        if (!out)
+            throw std::runtime_error("failed writing " + fileName);
+    }
+
+    // Every worker's tiles, in start order
+    std::vector<TileEvent> tileEvents() const
+    {
+        std::vector<TileEvent> tiles;
+        for (const WorkerSlot &slot : slots_)
+            tiles.insert(tiles.end(), slot.tiles_.begin(), slot.tiles_.end());
+        std::sort(tiles.begin(), tiles.end(), [](const TileEvent &a, const TileEvent &b)
+                  { return a.startMicroseconds_ < b.startMicroseconds_; });
+        return tiles;
+    }
+
+private:
+    struct alignas(64) WorkerSlot
+    {
+        RenderCounters counters_;
+        std::vector<TileEvent> tiles_;
+    };
+
+    std::vector<WorkerSlot> slots_;
+    Clock::time_point renderStart_{};
+};
+
+#endif // RAYTRACER_STATISTICS_H
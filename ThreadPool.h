@@ -0,0 +1,191 @@
+#ifndef RAYTRACER_THREAD_POOL_H
+#define RAYTRACER_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads. Each run() deals tasks out to per-worker deques;
+// a worker takes from the front of its own deque and steals from the back of the others once it runs dry.
+class ThreadPool
+{
+public:
+    using Task = std::function<void(size_t taskIndex, int workerIndex)>;
+
+    explicit ThreadPool(int threadCount = 0)
+    {
+        if (threadCount <= 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+        busySeconds_.assign(threadCount, 0.0);
+        for (int i = 0; i < threadCount; ++i)
+            queues_.push_back(std::make_unique<WorkerQueue>());
+        for (int i = 0; i < threadCount; ++i)
+            threads_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto &thread : threads_)
+            thread.join();
+    }
+
+    int threadCount() const { return static_cast<int>(threads_.size()); }
+
+    // Busy time of every worker during the last run(), in seconds
+    const std::vector<double> &busySeconds() const { return busySeconds_; }
+
+    // Runs task(i, worker) for every i in [0, taskCount) and blocks until all of them are done.
+    // Neighbouring task indices start on the same worker, so ordered tasks keep their locality.
+    // If a task throws, no further tasks are started and the first exception is rethrown here once every worker has stopped.
+    void run(size_t taskCount, const Task &task)
+    {
+        if (taskCount == 0)
+            return;
+
+        size_t workerCount = queues_.size();
+        for (size_t w = 0; w < workerCount; ++w)
+        {
+            size_t begin = taskCount * w / workerCount;
+            size_t end = taskCount * (w + 1) / workerCount;
+            std::lock_guard<std::mutex> lock(queues_[w]->mutex_);
+            for (size_t i = begin; i < end; ++i)
+                queues_[w]->tasks_.push_back(i);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::fill(busySeconds_.begin(), busySeconds_.end(), 0.0);
+        task_ = &task;
+        remainingTasks_ = taskCount;
+        failed_ = false;
+        activeWorkers_ = static_cast<int>(workerCount);
+        ++generation_;
+        wake_.notify_all();
+        done_.wait(lock, [this]
+                   { return activeWorkers_ == 0; });
+        task_ = nullptr;
+
+        if (error_)
+        {
+            for (auto &queue : queues_) // Tasks left behind by the failure
+            {
+                std::lock_guard<std::mutex> queueLock(queue->mutex_);
+                queue->tasks_.clear();
+            }
+            std::exception_ptr error = std::move(error_);
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex mutex_;
+        std::deque<size_t> tasks_;
+    };
+
+    std::vector<std::thread> threads_;
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<double> busySeconds_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const Task *task_{nullptr};
+    std::atomic<size_t> remainingTasks_{0};
+    int activeWorkers_{0};
+    unsigned long generation_{0};
+    bool stopping_{false};
+    std::atomic<bool> failed_{false};
+    std::exception_ptr error_; // First exception thrown by a task of the current run
+
+    bool popOwn(int workerIndex, size_t &taskIndex)
+    {
+        WorkerQueue &queue = *queues_[workerIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex_);
+        if (queue.tasks_.empty())
+            return false;
+        taskIndex = queue.tasks_.front();
+        queue.tasks_.pop_front();
+        return true;
+    }
+
+    bool steal(int workerIndex, size_t &taskIndex)
+    {
+        int workerCount = static_cast<int>(queues_.size());
+        for (int offset = 1; offset < workerCount; ++offset)
+        {
+            WorkerQueue &victim = *queues_[(workerIndex + offset) % workerCount];
+            std::lock_guard<std::mutex> lock(victim.mutex_);
+            if (!victim.tasks_.empty())
+            {
+                taskIndex = victim.tasks_.back(); // Take the end furthest from where the victim is working
+                victim.tasks_.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(int workerIndex)
+    {
+        unsigned long seenGeneration = 0;
+        while (true)
+        {
+            const Task *task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&]
+                           { return stopping_ || generation_ != seenGeneration; });
+                if (stopping_)
+                    return;
+                seenGeneration = generation_;
+                task = task_;
+            }
+
+            double busy = 0.0;
+            size_t taskIndex;
+            while (!failed_.load() && remainingTasks_.load() > 0 && (popOwn(workerIndex, taskIndex) || steal(workerIndex, taskIndex)))
+            {
+                auto start = std::chrono::steady_clock::now();
+                try
+                {
+                    (*task)(taskIndex, workerIndex);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!error_)
+                        error_ = std::current_exception();
+                    failed_ = true; // Every worker stops taking tasks
+                }
+                busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                --remainingTasks_;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            busySeconds_[workerIndex] = busy;
+            if (--activeWorkers_ == 0)
+                done_.notify_all();
+        }
+    }
+};
+
+#endif // RAYTRACER_THREAD_POOL_H
@@ -0,0 +1,62 @@
+#ifndef RAYTRACER_TILE_H
+#define RAYTRACER_TILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Rectangle of pixels [x0_, x1_) x [y0_, y1_)
+struct Tile
+{
+    int x0_, y0_, x1_, y1_;
+
+    int width() const { return x1_ - x0_; }
+    int height() const { return y1_ - y0_; }
+    int pixelCount() const { return width() * height(); }
+};
+
+// Interleaves the bits of x and y (Z-order curve)
+inline uint32_t mortonCode2D(uint32_t x, uint32_t y)
+{
+    auto spread = [](uint32_t v)
+    {
+        v &= 0x0000ffff;
+        v = (v | (v << 8)) & 0x00ff00ff;
+        v = (v | (v << 4)) & 0x0f0f0f0f;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+// Splits the image into tileSize x tileSize tiles ordered along a Morton curve,
+// so consecutive tiles are spatial neighbours and touch similar parts of the scene
+inline std::vector<Tile> makeTiles(int imageWidth, int imageHeight, int tileSize)
+{
+    tileSize = std::max(tileSize, 1);
+    int tilesX = (imageWidth + tileSize - 1) / tileSize;
+    int tilesY = (imageHeight + tileSize - 1) / tileSize;
+
+    std::vector<std::pair<uint32_t, Tile>> ordered;
+    ordered.reserve(tilesX * tilesY);
+    for (int ty = 0; ty < tilesY; ++ty)
+    {
+        for (int tx = 0; tx < tilesX; ++tx)
+        {
+            Tile tile{tx * tileSize, ty * tileSize,
+                      std::min((tx + 1) * tileSize, imageWidth), std::min((ty + 1) * tileSize, imageHeight)};
+            ordered.push_back({mortonCode2D(tx, ty), tile});
+        }
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const auto &a, const auto &b)
+              { return a.first < b.first; });
+
+    std::vector<Tile> tiles;
+    tiles.reserve(ordered.size());
+    for (const auto &entry : ordered)
+        tiles.push_back(entry.second);
+    return tiles;
+}
+
+#endif // RAYTRACER_TILE_H
@@ -0,0 +1,156 @@
+#ifndef RAYTRACER_TRANSFORM_H
+#define RAYTRACER_TRANSFORM_H
+
+#include <cmath>
+#include <stdexcept>
+#include "AABB.h"
+#include "Ray.h"
+#include "Vector3.h"
+
+// Affine transform stored as the top three rows of a 4x4 matrix, together with its inverse
+class Transform
+{
+public:
+    Transform() : Transform(identityMatrix(), identityMatrix()) {}
+
+    static Transform translation(const Vector3 &offset)
+    {
+        Matrix forward = identityMatrix();
+        Matrix inverse = identityMatrix();
+        for (int row = 0; row < 3; ++row)
+        {
+            forward.m_[row][3] = offset[row];
+            inverse.m_[row][3] = -offset[row];
+        }
+        return Transform(forward, inverse);
+    }
+
+    static Transform scale(double factor)
+    {
+        return scale(Vector3(factor, factor, factor));
+    }
+
+    static Transform scale(const Vector3 &factors)
+    {
+        if (factors.x() == 0.0 || factors.y() == 0.0 || factors.z() == 0.0)
+            throw std::invalid_argument("Transform::scale: zero scale factor");
+        Matrix forward = identityMatrix();
+        Matrix inverse = identityMatrix();
+        for (int row = 0; row < 3; ++row)
+        {
+            forward.m_[row][row] = factors[row];
+            inverse.m_[row][row] = 1.0 / factors[row];
+        }
+        return Transform(forward, inverse);
+    }
+
+    // Rotation by angleDegrees around the given axis (Rodrigues' formula); the inverse is the transpose
+    static Transform rotation(const Vector3 &axis, double angleDegrees)
+    {
+        Vector3 a = axis.unitVector();
+        double angle = degreesToRadians(angleDegrees);
+        double c = std::cos(angle), s = std::sin(angle), t = 1.0 - c;
+        Matrix forward = identityMatrix();
+        forward.m_[0][0] = t * a.x() * a.x() + c;
+        forward.m_[0][1] = t * a.x() * a.y() - s * a.z();
+        forward.m_[0][2] = t * a.x() * a.z() + s * a.y();
+        forward.m_[1][0] = t * a.x() * a.y() + s * a.z();
+        forward.m_[1][1] = t * a.y() * a.y() + c;
+        forward.m_[1][2] = t * a.y() * a.z() - s * a.x();
+        forward.m_[2][0] = t * a.x() * a.z() - s * a.y();
+        forward.m_[2][1] = t * a.y() * a.z() + s * a.x();
+        forward.m_[2][2] = t * a.z() * a.z() + c;
+        Matrix inverse = identityMatrix();
+        for (int row = 0; row < 3; ++row)
+            for (int column = 0; column < 3; ++column)
+                inverse.m_[row][column] = forward.m_[column][row];
+        return Transform(forward, inverse);
+    }
+
+    // Applies `other` first, then this transform
+    Transform operator*(const Transform &other) const
+    {
+        return Transform(multiply(forward_, other.forward_), multiply(other.inverse_, inverse_));
+    }
+
+    Transform inverse() const { return Transform(inverse_, forward_); }
+
+    Point3 applyToPoint(const Point3 &p) const { return applyPoint(forward_, p); }
+    Vector3 applyToVector(const Vector3 &v) const { return applyVector(forward_, v); }
+
+    // Normals transform with the inverse transpose so they stay perpendicular to the surface
+    Vector3 applyToNormal(const Vector3 &n) const
+    {
+        return Vector3(inverse_.m_[0][0] * n.x() + inverse_.m_[1][0] * n.y() + inverse_.m_[2][0] * n.z(),
+                       inverse_.m_[0][1] * n.x() + inverse_.m_[1][1] * n.y() + inverse_.m_[2][1] * n.z(),
+                       inverse_.m_[0][2] * n.x() + inverse_.m_[1][2] * n.y() + inverse_.m_[2][2] * n.z());
+    }
+
+    // The direction is not renormalised, so hit distances are the same in both spaces
+    Ray inverseApplyToRay(const Ray &ray) const
+    {
+        return Ray(applyPoint(inverse_, ray.origin()), applyVector(inverse_, ray.direction()));
+    }
+
+    // Box around the eight transformed corners
+    AABB applyToBox(const AABB &box) const
+    {
+        AABB result = AABB::emptyBox();
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            Point3 p((corner & 1) ? box.max().x() : box.min().x(),
+                     (corner & 2) ? box.max().y() : box.min().y(),
+                     (corner & 4) ? box.max().z() : box.min().z());
+            result = surroundingBox(result, applyToPoint(p));
+        }
+        return result;
+    }
+
+private:
+    struct Matrix
+    {
+        double m_[3][4];
+    };
+
+    Matrix forward_;
+    Matrix inverse_;
+
+    Transform(const Matrix &forward, const Matrix &inverse) : forward_{forward}, inverse_{inverse} {}
+
+    static Matrix identityMatrix()
+    {
+        return Matrix{{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}}};
+    }
+
+    static Matrix multiply(const Matrix &a, const Matrix &b)
+    {
+        Matrix result{};
+        for (int row = 0; row < 3; ++row)
+        {
+            for (int column = 0; column < 4; ++column)
+            {
+                double sum = (column == 3) ? a.m_[row][3] : 0.0;
+                for (int k = 0; k < 3; ++k)
+                    sum += a.m_[row][k] * b.m_[k][column];
+                result.m_[row][column] = sum;
+            }
+        }
+        return result;
+    }
+
+    static Point3 applyPoint(const Matrix &matrix, const Point3 &p)
+    {
+        return Point3(matrix.m_[0][0] * p.x() + matrix.m_[0][1] * p.y() + matrix.m_[0][2] * p.z() + matrix.m_[0][3],
+                      matrix.m_[1][0] * p.x() + matrix.m_[1][1] * p.y() + matrix.m_[1][2] * p.z() + matrix.m_[1][3],
+                      matrix.m_[2][0] * p.x() + matrix.m_[2][1] * p.y() + matrix.m_[2][2] * p.z() + matrix.m_[2][3]);
+    }
+
+    static Vector3 applyVector(const Matrix &matrix, const Vector3 &v)
+    {
+        return Vector3(matrix.m_[0][0] * v.x() + matrix.m_[0][1] * v.y() + matrix.m_[0][2] * v.z(),
+                       matrix.m_[1][0] * v.x() + matrix.m_[1][1] * v.y() + matrix.m_[1][2] * v.z(),
+                       matrix.m_[2][0] * v.x() + matrix.m_[2][1] * v.y() + matrix.m_[2][2] * v.z());
+    }
+};
+
+#endif // RAYTRACER_TRANSFORM_H
@@ -0,0 +1,286 @@
+#ifndef RAYTRACER_TRIANGLE_MESH_H
+#define RAYTRACER_TRIANGLE_MESH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "Scene.h"
+
+class TriangleMesh;
+
+// Lightweight reference to one triangle of a TriangleMesh; the mesh owns these in one contiguous array
+class Triangle : public Object
+{
+public:
+    Triangle(const TriangleMesh *mesh, uint32_t index) : mesh_{mesh}, index_{index} {}
+
+    bool intersect(const Ray &ray, Interval rayInterval, PrimitiveHit &hit) const override;
+    HitRecord surface(const Ray &ray, const PrimitiveHit &hit) const override;
+    bool occluded(const Ray &ray, Interval rayInterval) const override;
+    AABB boundingBox() const override;
+
+    uint32_t index() const { return index_; }
+    const TriangleMesh &mesh() const { return *mesh_; }
+
+private:
+    const TriangleMesh *mesh_;
+    uint32_t index_;
+
+    // Watertight ray/triangle test (Woop, Benthin and Wald 2013). Returns the distance and barycentrics.
+    bool intersectWatertight(const Ray &ray, Interval rayInterval, double &distance, double barycentric[3]) const;
+};
+
+// Indexed triangle mesh with vertex positions and optional normals stored as separate x/y/z arrays
+class TriangleMesh
+{
+public:
+    explicit TriangleMesh(MaterialId material) : material_{material} {}
+
+    // Triangles point back at the mesh, so it must stay where it was created
+    TriangleMesh(const TriangleMesh &) = delete;
+    TriangleMesh &operator=(const TriangleMesh &) = delete;
+
+    void reserve(size_t vertexCount, size_t triangleCount)
+    {
+        positionX_.reserve(vertexCount);
+        positionY_.reserve(vertexCount);
+        positionZ_.reserve(vertexCount);
+        indices_.reserve(triangleCount * 3);
+        triangles_.reserve(triangleCount);
+    }
+
+    uint32_t addVertex(float x, float y, float z)
+    {
+        positionX_.push_back(x);
+        positionY_.push_back(y);
+        positionZ_.push_back(z);
+        return static_cast<uint32_t>(positionX_.size() - 1);
+    }
+
+    // Normals are optional; when given there must be one per vertex
+    void addNormal(float x, float y, float z)
+    {
+        normalX_.push_back(x);
+        normalY_.push_back(y);
+        normalZ_.push_back(z);
+    }
+
+    void clearNormals()
+    {
+        normalX_.clear();
+        normalY_.clear();
+        normalZ_.clear();
+    }
+
+    // Triangles handed out by appendTriangles move when more are added, so add them all first
+    void addTriangle(uint32_t a, uint32_t b, uint32_t c)
+    {
+        indices_.push_back(a);
+        indices_.push_back(b);
+        indices_.push_back(c);
+        triangles_.emplace_back(this, static_cast<uint32_t>(triangles_.size()));
+    }
+
+    size_t vertexCount() const { return positionX_.size(); }
+    size_t triangleCount() const { return indices_.size() / 3; }
+    bool hasNormals() const { return !normalX_.empty() && normalX_.size() == positionX_.size(); }
+    MaterialId material() const { return material_; }
+
+    Point3 position(uint32_t vertex) const { return Point3(positionX_[vertex], positionY_[vertex], positionZ_[vertex]); }
+    Vector3 normal(uint32_t vertex) const { return Vector3(normalX_[vertex], normalY_[vertex], normalZ_[vertex]); }
+    uint32_t vertexIndex(uint32_t triangle, int corner) const { return indices_[3 * triangle + corner]; }
+
+    AABB boundingBox() const
+    {
+        AABB box = AABB::emptyBox();
+        for (size_t v = 0; v < vertexCount(); ++v)
+            box = surroundingBox(box, position(static_cast<uint32_t>(v)));
+        return box;
+    }
+
+    // Uniformly scales and moves the mesh so its longest side is `size` and its box is centred on `centre`
+    void fitToBox(const Point3 &centre, double size)
+    {
+        AABB box = boundingBox();
+        Vector3 extent = box.max() - box.min();
+        double longest = std::max({extent.x(), extent.y(), extent.z()});
+        double scale = (longest > 0.0) ? size / longest : 1.0;
+        Point3 middle = box.centroid();
+        for (size_t v = 0; v < vertexCount(); ++v)
+        {
+            positionX_[v] = static_cast<float>(centre.x() + (positionX_[v] - middle.x()) * scale);
+            positionY_[v] = static_cast<float>(centre.y() + (positionY_[v] - middle.y()) * scale);
+            positionZ_[v] = static_cast<float>(centre.z() + (positionZ_[v] - middle.z()) * scale);
+        }
+    }
+
+    // Raw arrays (positions and normals per axis, three indices per triangle), for caching a loaded mesh
+    std::span<const float> positions(int axis) const { return axis == 0 ? positionX_ : axis == 1 ? positionY_ : positionZ_; }
+    std::span<const float> normals(int axis) const { return axis == 0 ? normalX_ : axis == 1 ? normalY_ : normalZ_; }
+    std::span<const uint32_t> indices() const { return indices_; }
+
+    // Replaces the mesh data with copies of arrays produced by the accessors above
+    void assign(std::span<const float> positions[3], std::span<const float> normals[3], std::span<const uint32_t> indices)
+    {
+        if (positions[1].size() != positions[0].size() || positions[2].size() != positions[0].size() ||
+            normals[1].size() != normals[0].size() || normals[2].size() != normals[0].size() || indices.size() % 3 != 0)
+            throw std::invalid_argument("TriangleMesh::assign: inconsistent array sizes");
+        for (uint32_t index : indices)
+        {
+            if (index >= positions[0].size())
+                throw std::invalid_argument("TriangleMesh::assign: vertex index out of range");
+        }
+        positionX_.assign(positions[0].begin(), positions[0].end());
+        positionY_.assign(positions[1].begin(), positions[1].end());
+        positionZ_.assign(positions[2].begin(), positions[2].end());
+        normalX_.assign(normals[0].begin(), normals[0].end());
+        normalY_.assign(normals[1].begin(), normals[1].end());
+        normalZ_.assign(normals[2].begin(), normals[2].end());
+        indices_.assign(indices.begin(), indices.end());
+        triangles_.clear();
+        triangles_.reserve(triangleCount());
+        for (uint32_t t = 0; t < triangleCount(); ++t)
+            triangles_.emplace_back(this, t);
+    }
+
+    // Appends one reference per triangle to a BVH input list; every call hands out the same triangles
+    void appendTriangles(std::vector<Object *> &objects)
+    {
+        for (Triangle &triangle : triangles_)
+            objects.push_back(&triangle);
+    }
+
+private:
+    std::vector<float> positionX_, positionY_, positionZ_;
+    std::vector<float> normalX_, normalY_, normalZ_;
+    std::vector<uint32_t> indices_;
+    std::vector<Triangle> triangles_;
+    MaterialId material_;
+};
+
+inline bool Triangle::intersectWatertight(const Ray &ray, Interval rayInterval, double &distance, double barycentric[3]) const
+{
+    Vector3 direction = ray.direction();
+
+    // Shear and scale so the ray runs along +z from the origin; kz is the dominant direction axis
+    int kz = 0;
+    if (fabs(direction.y()) > fabs(direction[kz]))
+        kz = 1;
+    if (fabs(direction.z()) > fabs(direction[kz]))
+        kz = 2;
+    int kx = (kz + 1) % 3;
+    int ky = (kx + 1) % 3;
+    if (direction[kz] < 0.0)
+        std::swap(kx, ky); // Keep the winding so the edge function signs stay consistent
+
+    double shearX = direction[kx] / direction[kz];
+    double shearY = direction[ky] / direction[kz];
+    double shearZ = 1.0 / direction[kz];
+
+    Vector3 a = mesh_->position(mesh_->vertexIndex(index_, 0)) - ray.origin();
+    Vector3 b = mesh_->position(mesh_->vertexIndex(index_, 1)) - ray.origin();
+    Vector3 c = mesh_->position(mesh_->vertexIndex(index_, 2)) - ray.origin();
+
+    double ax = a[kx] - shearX * a[kz], ay = a[ky] - shearY * a[kz];
+    double bx = b[kx] - shearX * b[kz], by = b[ky] - shearY * b[kz];
+    double cx = c[kx] - shearX * c[kz], cy = c[ky] - shearY * c[kz];
+
+    // Scaled barycentrics; an edge exactly through the ray is re-evaluated in extended precision
+    double u = cx * by - cy * bx;
+    double v = ax * cy - ay * cx;
+    double w = bx * ay - by * ax;
+    if (u == 0.0 || v == 0.0 || w == 0.0)
+    {
+        u = static_cast<double>(static_cast<long double>(cx) * by - static_cast<long double>(cy) * bx);
+        v = static_cast<double>(static_cast<long double>(ax) * cy - static_cast<long double>(ay) * cx);
+        w = static_cast<double>(static_cast<long double>(bx) * ay - static_cast<long double>(by) * ax);
+    }
+    if ((u < 0.0 || v < 0.0 || w < 0.0) && (u > 0.0 || v > 0.0 || w > 0.0))
+        return false;
+
+    double determinant = u + v + w;
+    if (determinant == 0.0)
+        return false;
+
+    double scaledDistance = u * shearZ * a[kz] + v * shearZ * b[kz] + w * shearZ * c[kz];
+    distance = scaledDistance / determinant;
+    if (!rayInterval.surrounds(distance))
+        return false;
+
+    barycentric[0] = u / determinant;
+    barycentric[1] = v / determinant;
+    barycentric[2] = w / determinant;
+    return true;
+}
+
+inline bool Triangle::intersect(const Ray &ray, Interval rayInterval, PrimitiveHit &hit) const
+{
+    double distance;
+    double barycentric[3];
+    if (!intersectWatertight(ray, rayInterval, distance, barycentric))
+        return false;
+
+    hit.distance_ = distance;
+    hit.primitive_ = this;
+    hit.instance_ = nullptr;
+    hit.u_ = barycentric[1];
+    hit.v_ = barycentric[2];
+    return true;
+}
+
+inline HitRecord Triangle::surface(const Ray &ray, const PrimitiveHit &hit) const
+{
+    uint32_t i0 = mesh_->vertexIndex(index_, 0), i1 = mesh_->vertexIndex(index_, 1), i2 = mesh_->vertexIndex(index_, 2);
+    Point3 p0 = mesh_->position(i0);
+    Vector3 outwardNormal = (mesh_->position(i1) - p0).cross(mesh_->position(i2) - p0).unitVector();
+    if (mesh_->hasNormals())
+    {
+        // Interpolated shading normal, flipped into the same hemisphere as the geometric one
+        Vector3 shadingNormal = (mesh_->normal(i0) * (1.0 - hit.u_ - hit.v_) + mesh_->normal(i1) * hit.u_ + mesh_->normal(i2) * hit.v_);
+        if (!shadingNormal.nearZero())
+        {
+            shadingNormal = shadingNormal.unitVector();
+            outwardNormal = (shadingNormal.dot(outwardNormal) < 0.0) ? -shadingNormal : shadingNormal;
+        }
+    }
+
+    HitRecord rec;
+    rec.setHitPoint(ray.pointAlongRay(hit.distance_));
+    rec.setSurfaceNormal(outwardNormal);
+    rec.setDistanceAlongRay(hit.distance_);
+    rec.setFrontFace(ray.direction(), outwardNormal);
+    rec.setMaterialId(mesh_->material());
+    return rec;
+}
+
+inline bool Triangle::occluded(const Ray &ray, Interval rayInterval) const
+{
+    double distance;
+    double barycentric[3];
+    return intersectWatertight(ray, rayInterval, distance, barycentric);
+}
+
+inline AABB Triangle::boundingBox() const
+{
+    Point3 p0 = mesh_->position(mesh_->vertexIndex(index_, 0));
+    Point3 p1 = mesh_->position(mesh_->vertexIndex(index_, 1));
+    Point3 p2 = mesh_->position(mesh_->vertexIndex(index_, 2));
+    AABB box = surroundingBox(AABB(p0, p0), surroundingBox(AABB(p1, p1), AABB(p2, p2)));
+
+    // Axis-aligned triangles would give a zero-thickness box, which the slab test never reports as hit
+    const double padding = 1e-4;
+    Point3 low = box.min(), high = box.max();
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (high[axis] - low[axis] < padding)
+        {
+            low[axis] -= padding / 2;
+            high[axis] += padding / 2;
+        }
+    }
+    return AABB(low, high);
+}
+
+#endif // RAYTRACER_TRIANGLE_MESH_H
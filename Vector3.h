@@ -1,163 +1,173 @@
 #ifndef RAYTRACER_VECTOR3_H
 #define RAYTRACER_VECTOR3_H
 
+#include <cassert>
 #include "HelperFunctions.h"
 
-
-class Vector3 {
+// Three components of Scalar (float or double, see Real) kept in one array, so indexing is a plain load.
+// The array is packed: 12 bytes for float against 24 for double. SIMD code (the wide BVH) keeps its own
+// aligned arrays, so padding here would only cost memory.
+template <typename Scalar>
+class Vector3T {
 public:
-    Vector3() = default;
-    Vector3(double inX, double inY, double inZ) : x_{inX}, y_{inY}, z_{inZ} {};
+    Vector3T() = default;
+    Vector3T(double inX, double inY, double inZ)
+        : e_{static_cast<Scalar>(inX), static_cast<Scalar>(inY), static_cast<Scalar>(inZ)} {};
 
-    double x() const { return x_; }
-    double y() const { return y_; }
-    double z() const { return z_; }
+    Scalar x() const { return e_[0]; }
+    Scalar y() const { return e_[1]; }
+    Scalar z() const { return e_[2]; }
 
-    Vector3 operator-() const { return {*this}; }
+    Vector3T operator-() const { return {-e_[0], -e_[1], -e_[2]}; }
 
-    Vector3& operator+=(const Vector3& inVec) {
-        x_ += inVec.x();
-        y_ += inVec.y();
-        z_ += inVec.z();
+    Vector3T& operator+=(const Vector3T& inVec) {
+        e_[0] += inVec.e_[0];
+        e_[1] += inVec.e_[1];
+        e_[2] += inVec.e_[2];
 
         return *this;
     }
 
-    Vector3& operator*=(double scale) {
-        x_ *= scale;
-        y_ *= scale;
-        z_ *= scale;
+    Vector3T& operator*=(Scalar scale) {
+        e_[0] *= scale;
+        e_[1] *= scale;
+        e_[2] *= scale;
 
         return *this;
     }
 
-    Vector3& operator/=(double scale) {
-        return *this *= (1 / scale);
+    Vector3T& operator/=(Scalar scale) {
+        return *this *= (Scalar(1) / scale);
     }
 
-    Vector3 operator+(const Vector3 other) const {
+    Vector3T operator+(const Vector3T other) const {
         return {x() + other.x(), y() + other.y(), z() + other.z()};
     }
 
-    Vector3 operator-(const Vector3 other) const {
+    Vector3T operator-(const Vector3T other) const {
         return {x() - other.x(), y() - other.y(), z() - other.z()};
     }
 
-    Vector3 operator*(double scale) const {
+    Vector3T operator*(Scalar scale) const {
         return {scale * x(), scale * y(), scale * z()};
     }
 
-    friend Vector3 operator*(double scale, Vector3& vector) {
+    friend Vector3T operator*(Scalar scale, const Vector3T& vector) {
         return vector * scale;
     }
 
-    Vector3 operator/(double scale) const {
-        return *this * (1 / scale);
+    Vector3T operator/(Scalar scale) const {
+        return *this * (Scalar(1) / scale);
     }
 
-    friend Vector3 operator/(double scale, Vector3& vector) {
-        return vector * (1 / scale);
+    friend Vector3T operator/(Scalar scale, const Vector3T& vector) {
+        return vector * (Scalar(1) / scale);
     }
 
-    double operator[](int index) const {
-        switch (index) {
-            case 0: return x();
-            case 1: return y();
-            case 2: return z();
-            default: throw std::out_of_range("Index out of range for Vector3");
-        }
+    // No range check beyond a debug assertion, so loops over the axes stay branch-free
+    Scalar operator[](int index) const {
+        assert(index >= 0 && index < 3);
+        return e_[index];
     }
 
-    double& operator[](int index) {
-        switch (index) {
-            case 0: return x_;
-            case 1: return y_;
-            case 2: return z_;
-            default: throw std::out_of_range("Index out of range for Vector3");
-        }
+    Scalar& operator[](int index) {
+        assert(index >= 0 && index < 3);
+        return e_[index];
     }
-    
-    double dot(const Vector3& other) const {
+
+    Scalar dot(const Vector3T& other) const {
         return (x() * other.x()) + (y() * other.y()) + (z() * other.z());
     }
 
-    Vector3 cross(const Vector3 other) const {
+    Vector3T cross(const Vector3T other) const {
         return { (y() * other.z()) - (z() * other.y()),
                  (z() * other.x()) - (x() * other.z()),
                  (x() * other.y()) - (y() * other.x()) };
     }
 
-    friend std::ostream& operator<<(std::ostream& outStream, const Vector3& v) {
+    friend std::ostream& operator<<(std::ostream& outStream, const Vector3T& v) {
         return outStream << v.x() << ' ' << v.y() << ' ' << v.z() ;
     }
 
-    double length_squared() const {
+    Scalar length_squared() const {
         return x()*x() + y()*y() + z()*z();
     }
 
-    double length() const {
-        return sqrt(length_squared());
+    Scalar length() const {
+        return std::sqrt(length_squared());
     }
 
-    Vector3 unitVector() const {
-        return {x() / length(), y() / length(), z() / length()};
+    Vector3T unitVector() const {
+        return *this * (Scalar(1) / length()); // One square root and one division for all three components
     }
 
     bool nearZero(double epsilon = 1e-8) const {
-        return (fabs(x()) < epsilon) && (fabs(y()) < epsilon) && (fabs(z()) < epsilon);
+        return (std::fabs(x()) < epsilon) && (std::fabs(y()) < epsilon) && (std::fabs(z()) < epsilon);
     }
 
-    Vector3 reflectionAboutNormalVector(const Vector3& normalVector) const {
+    Vector3T reflectionAboutNormalVector(const Vector3T& normalVector) const {
         auto self = *this;
         return self - (normalVector * (2 * self.dot(normalVector)));
     }
 
-    Vector3 refractionAboutNormalVector(const Vector3& normalVector, double refractiveIndexRatio) const {
+    Vector3T refractionAboutNormalVector(const Vector3T& normalVector, double refractiveIndexRatio) const {
         auto self = *this;
         double cosineTheta = fmin(-self.dot(normalVector), 1.0);
-        Vector3 perpendicularComponent = (self + (normalVector * cosineTheta)) * refractiveIndexRatio;
-        Vector3 parallelComponent = normalVector * -sqrt(fabs(1.0 - perpendicularComponent.length_squared()));
+        Vector3T perpendicularComponent = (self + (normalVector * cosineTheta)) * refractiveIndexRatio;
+        Vector3T parallelComponent = normalVector * -sqrt(fabs(1.0 - perpendicularComponent.length_squared()));
         return perpendicularComponent + parallelComponent;
     }
 
-    static Vector3 random0to1() {
+    static Vector3T random0to1() {
         return {randomDouble0to1(), randomDouble0to1(), randomDouble0to1()};
     }
 
-    static Vector3 randomInRange(double minimum, double maximum) {
+    static Vector3T randomInRange(double minimum, double maximum) {
         return {randomDouble(minimum, maximum), randomDouble(minimum, maximum), randomDouble(minimum, maximum)};
     }
 
-    static Vector3 randomInUnitSphere() {
-        while (true) {
-            Vector3 temp = randomInRange(-1, 1);
-            if (temp.length_squared() < 1)
-                return temp;
-        }
+    // Direct mappings from uniform samples in [0, 1): no rejection loops, a fixed number of draws each
+
+    static Vector3T unitVectorFromSamples(double u1, double u2) {
+        double z = 1.0 - 2.0 * u1;
+        double radius = sqrt(fmax(0.0, 1.0 - z * z));
+        double phi = 2.0 * pi * u2;
+        return {radius * cos(phi), radius * sin(phi), z};
+    }
+
+    static Vector3T inUnitSphereFromSamples(double u1, double u2, double u3) {
+        return unitVectorFromSamples(u1, u2) * cbrt(u3);
     }
 
-    static Vector3 randomInUnitDisk() {
-        while (true) {
-            auto temp = Vector3(randomDouble(-1, 1), randomDouble(-1, 1), 0);
-            if (temp.length_squared() < 1)
-                return temp;
-        }
+    static Vector3T inUnitDiskFromSamples(double u1, double u2) {
+        double radius = sqrt(u1);
+        double phi = 2.0 * pi * u2;
+        return {radius * cos(phi), radius * sin(phi), 0};
     }
 
-    static Vector3 randomUnitVector() {
-        return randomInUnitSphere().unitVector();
+    static Vector3T randomInUnitSphere() {
+        return inUnitSphereFromSamples(randomDouble0to1(), randomDouble0to1(), randomDouble0to1());
     }
 
-    static Vector3 randomOnHemisphere(const Vector3& normalVector) {
-        Vector3 temp = randomUnitVector();
+    static Vector3T randomInUnitDisk() {
+        return inUnitDiskFromSamples(randomDouble0to1(), randomDouble0to1());
+    }
+
+    static Vector3T randomUnitVector() {
+        return unitVectorFromSamples(randomDouble0to1(), randomDouble0to1());
+    }
+
+    static Vector3T randomOnHemisphere(const Vector3T& normalVector) {
+        Vector3T temp = randomUnitVector();
         return (temp.dot(normalVector) > 0.0) ? temp : -temp;
     }
 private:
-    double x_ {0.0};
-    double y_ {0.0};
-    double z_ {0.0};
+    Scalar e_[3] {0, 0, 0};
 };
 
+static_assert(sizeof(Vector3T<float>) == 3 * sizeof(float), "float vectors must stay packed");
+
+using Vector3 = Vector3T<Real>;
 using Point3 = Vector3;
 
 
@@ -0,0 +1,581 @@
+#ifndef RAYTRACER_WIDE_BVH_H
+#define RAYTRACER_WIDE_BVH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "BVHNode.h"
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// Widest node layout the compiler can test with a single SIMD slab test
+#if defined(__AVX2__)
+constexpr int preferredBVHWidth = 8;
+#else
+constexpr int preferredBVHWidth = 4;
+#endif
+
+// Child bounds are stored as structure-of-arrays so all children are tested at once.
+// A child slot is either an interior node (primitiveCount_ == 0), a leaf, or empty (inverted bounds).
+template <int Width>
+struct alignas(32) WideBVHNode
+{
+    float minX_[Width], minY_[Width], minZ_[Width];
+    float maxX_[Width], maxY_[Width], maxZ_[Width];
+    uint32_t child_[Width];          // Interior: node index. Leaf: first primitive
+    uint16_t primitiveCount_[Width]; // 0 for interior children and empty slots
+};
+
+template <int Width>
+class WideBVH : public Object
+{
+    static_assert(Width == 4 || Width == 8, "WideBVH supports 4- and 8-wide nodes");
+
+public:
+    static constexpr uint32_t emptySlot = std::numeric_limits<uint32_t>::max();
+    static constexpr int traversalStackSize = 64 * (Width - 1) + 1;
+
+    // params only supplies the cost constants that later refits measure against
+    explicit WideBVH(const BVHNode &root, const BVHBuildParameters &params = BVHBuildParameters::defaultParameters())
+    {
+        buildFrom(root, params);
+    }
+
+    // Uses nodes built earlier (for example from a mapped BVHCache) in place; they must outlive this BVH.
+    // primitives must be in the order the leaves index them.
+    WideBVH(std::span<const WideBVHNode<Width>> nodes, std::vector<const Object *> primitives, const AABB &box)
+        : nodes_{nodes}, primitives_{std::move(primitives)}, box_{box}
+    {
+    }
+
+    WideBVH(const WideBVH &) = delete;
+    WideBVH &operator=(const WideBVH &) = delete;
+
+    bool intersect(const Ray &ray, Interval rayInterval, PrimitiveHit &hit) const override
+    {
+        if (primitives_.empty())
+            return false;
+
+        RayData rayData(ray);
+        bool hitAnything = false;
+        double closestSoFar = rayInterval.max();
+
+        StackEntry stack[traversalStackSize];
+        int stackSize = 0;
+        stack[stackSize++] = {0, 0, -std::numeric_limits<float>::infinity()};
+
+        while (stackSize > 0)
+        {
+            StackEntry entry = stack[--stackSize];
+            if (entry.tNear_ > closestSoFar)
+                continue; // Something closer was found after this entry was pushed
+
+            if (entry.primitiveCount_ > 0)
+            {
+                for (uint32_t i = 0; i < entry.primitiveCount_; ++i)
+                {
+                    RAYTRACER_COUNT(primitiveTests_, 1);
+                    if (primitives_[entry.index_ + i]->intersect(ray, Interval(rayInterval.min(), closestSoFar), hit))
+                    {
+                        hitAnything = true;
+                        closestSoFar = hit.distance_;
+                    }
+                }
+                continue;
+            }
+
+            const WideBVHNode<Width> &node = nodes_[entry.index_];
+            RAYTRACER_COUNT(nodesVisited_, 1);
+            alignas(32) float tNear[Width];
+            int hitMask = intersectChildren(node, rayData, static_cast<float>(rayInterval.min()), static_cast<float>(closestSoFar), tNear);
+
+            // Push hit children furthest first so the nearest one is popped next
+            int firstPushed = stackSize;
+            while (hitMask)
+            {
+                int slot = __builtin_ctz(hitMask);
+                hitMask &= hitMask - 1;
+                StackEntry child{node.child_[slot], node.primitiveCount_[slot], tNear[slot]};
+                int position = stackSize++;
+                while (position > firstPushed && stack[position - 1].tNear_ < child.tNear_)
+                {
+                    stack[position] = stack[position - 1];
+                    --position;
+                }
+                stack[position] = child;
+            }
+        }
+        return hitAnything;
+    }
+
+    bool occluded(const Ray &ray, Interval rayInterval) const override
+    {
+        if (primitives_.empty())
+            return false;
+
+        RayData rayData(ray);
+        float tMin = static_cast<float>(rayInterval.min());
+        float tMax = static_cast<float>(rayInterval.max());
+
+        // Any hit ends the query, so children are pushed unsorted
+        StackEntry stack[traversalStackSize];
+        int stackSize = 0;
+        stack[stackSize++] = {0, 0, tMin};
+
+        while (stackSize > 0)
+        {
+            StackEntry entry = stack[--stackSize];
+            if (entry.primitiveCount_ > 0)
+            {
+                for (uint32_t i = 0; i < entry.primitiveCount_; ++i)
+                {
+                    RAYTRACER_COUNT(primitiveTests_, 1);
+                    if (primitives_[entry.index_ + i]->occluded(ray, rayInterval))
+                        return true;
+                }
+                continue;
+            }
+
+            const WideBVHNode<Width> &node = nodes_[entry.index_];
+            RAYTRACER_COUNT(nodesVisited_, 1);
+            alignas(32) float tNear[Width];
+            int hitMask = intersectChildren(node, rayData, tMin, tMax, tNear);
+            while (hitMask)
+            {
+                int slot = __builtin_ctz(hitMask);
+                hitMask &= hitMask - 1;
+                stack[stackSize++] = {node.child_[slot], node.primitiveCount_[slot], tNear[slot]};
+            }
+        }
+        return false;
+    }
+
+    AABB boundingBox() const override
+    {
+        return box_;
+    }
+
+    std::span<const WideBVHNode<Width>> nodes() const { return nodes_; }
+    const std::vector<const Object *> &primitives() const { return primitives_; }
+
+    // For primitives that moved but are still the same set: recomputes every box bottom-up in place, keeping
+    // the topology, then rebuilds only the subtrees whose SAH cost has grown past params.refitRebuildThreshold_
+    // times their cost when they were built. Returns the number of subtrees rebuilt (1 for the whole tree).
+    // Only BVHs that own their nodes can be refitted, not ones mapped from a cache.
+    int refit(const BVHBuildParameters &params = BVHBuildParameters::defaultParameters())
+    {
+        if (ownedNodes_.empty())
+            throw std::logic_error("WideBVH::refit: nodes are not owned by this BVH");
+        if (primitives_.empty())
+            return 0;
+
+        box_ = refitNode(0, params).box_;
+        if (cost_[0] > params.refitRebuildThreshold_ * buildCost_[0])
+        {
+            rebuildAll(params);
+            return 1;
+        }
+        int rebuilt = rebuildDegraded(0, 1, params);
+        if (2 * deadNodes_ > ownedNodes_.size())
+        {
+            rebuildAll(params); // Rebuilt subtrees leave their old nodes behind; compact once they dominate
+            return rebuilt + 1;
+        }
+        return rebuilt;
+    }
+
+private:
+    std::span<const WideBVHNode<Width>> nodes_; // ownedNodes_, or nodes stored elsewhere
+    std::vector<WideBVHNode<Width>> ownedNodes_;
+    std::vector<const Object *> primitives_;
+    AABB box_;
+    std::vector<double> buildCost_; // Per owned node: SAH cost of its subtree when built, relative to its own area
+    std::vector<double> cost_;      // Same after the last refit
+    size_t deadNodes_{0};           // Owned nodes no longer reachable after subtree rebuilds
+
+    struct StackEntry
+    {
+        uint32_t index_;          // Node index, or first primitive for leaves
+        uint32_t primitiveCount_; // 0 for interior nodes
+        float tNear_;
+    };
+
+    struct RayData
+    {
+        float origin_[3];
+        float inverseDirection_[3];
+        bool directionIsNegative_[3];
+
+        explicit RayData(const Ray &ray)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                origin_[axis] = static_cast<float>(ray.origin()[axis]);
+                inverseDirection_[axis] = 1.0f / static_cast<float>(ray.direction()[axis]);
+                directionIsNegative_[axis] = inverseDirection_[axis] < 0.0f;
+            }
+        }
+    };
+
+    // Widen tFar by a few float ulps so rounding never rejects a box the double-precision test accepts
+    static constexpr float farScale = 1.0f + 4.0f * std::numeric_limits<float>::epsilon();
+
+    // Returns a bit mask of the children whose boxes overlap [tMin, tMax], and their entry distances
+    static int intersectChildren(const WideBVHNode<Width> &node, const RayData &ray, float tMin, float tMax, float *tNear)
+    {
+        const float *nearX = ray.directionIsNegative_[0] ? node.maxX_ : node.minX_;
+        const float *farX = ray.directionIsNegative_[0] ? node.minX_ : node.maxX_;
+        const float *nearY = ray.directionIsNegative_[1] ? node.maxY_ : node.minY_;
+        const float *farY = ray.directionIsNegative_[1] ? node.minY_ : node.maxY_;
+        const float *nearZ = ray.directionIsNegative_[2] ? node.maxZ_ : node.minZ_;
+        const float *farZ = ray.directionIsNegative_[2] ? node.minZ_ : node.maxZ_;
+
+#if defined(__AVX2__)
+        if constexpr (Width == 8)
+        {
+            __m256 originX = _mm256_set1_ps(ray.origin_[0]), inverseX = _mm256_set1_ps(ray.inverseDirection_[0]);
+            __m256 originY = _mm256_set1_ps(ray.origin_[1]), inverseY = _mm256_set1_ps(ray.inverseDirection_[1]);
+            __m256 originZ = _mm256_set1_ps(ray.origin_[2]), inverseZ = _mm256_set1_ps(ray.inverseDirection_[2]);
+
+            // NaNs from 0 * inf are discarded because max/min return their second operand on NaN
+            __m256 entry = _mm256_set1_ps(tMin);
+            entry = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(nearX), originX), inverseX), entry);
+            entry = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(nearY), originY), inverseY), entry);
+            entry = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(nearZ), originZ), inverseZ), entry);
+            __m256 exit = _mm256_set1_ps(tMax);
+            exit = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(farX), originX), inverseX), exit);
+            exit = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(farY), originY), inverseY), exit);
+            exit = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(farZ), originZ), inverseZ), exit);
+            exit = _mm256_mul_ps(exit, _mm256_set1_ps(farScale));
+
+            _mm256_store_ps(tNear, entry);
+            return _mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ));
+        }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+        if constexpr (Width == 4)
+        {
+            __m128 originX = _mm_set1_ps(ray.origin_[0]), inverseX = _mm_set1_ps(ray.inverseDirection_[0]);
+            __m128 originY = _mm_set1_ps(ray.origin_[1]), inverseY = _mm_set1_ps(ray.inverseDirection_[1]);
+            __m128 originZ = _mm_set1_ps(ray.origin_[2]), inverseZ = _mm_set1_ps(ray.inverseDirection_[2]);
+
+            __m128 entry = _mm_set1_ps(tMin);
+            entry = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearX), originX), inverseX), entry);
+            entry = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearY), originY), inverseY), entry);
+            entry = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearZ), originZ), inverseZ), entry);
+            __m128 exit = _mm_set1_ps(tMax);
+            exit = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farX), originX), inverseX), exit);
+            exit = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farY), originY), inverseY), exit);
+            exit = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farZ), originZ), inverseZ), exit);
+            exit = _mm_mul_ps(exit, _mm_set1_ps(farScale));
+
+            _mm_store_ps(tNear, entry);
+            return _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+        }
+#endif
+        // Scalar fallback for targets without the matching SIMD instructions
+        int hitMask = 0;
+        for (int slot = 0; slot < Width; ++slot)
+        {
+            float entry = tMin;
+            float exit = tMax;
+            entry = slabMax((nearX[slot] - ray.origin_[0]) * ray.inverseDirection_[0], entry);
+            entry = slabMax((nearY[slot] - ray.origin_[1]) * ray.inverseDirection_[1], entry);
+            entry = slabMax((nearZ[slot] - ray.origin_[2]) * ray.inverseDirection_[2], entry);
+            exit = slabMin((farX[slot] - ray.origin_[0]) * ray.inverseDirection_[0], exit);
+            exit = slabMin((farY[slot] - ray.origin_[1]) * ray.inverseDirection_[1], exit);
+            exit = slabMin((farZ[slot] - ray.origin_[2]) * ray.inverseDirection_[2], exit);
+            tNear[slot] = entry;
+            if (entry <= exit * farScale)
+                hitMask |= 1 << slot;
+        }
+        return hitMask;
+    }
+
+    // Same NaN behaviour as the SIMD max/min: a NaN slab distance is ignored
+    static float slabMax(float value, float current) { return value > current ? value : current; }
+    static float slabMin(float value, float current) { return value < current ? value : current; }
+
+    static float roundDown(double value)
+    {
+        float rounded = static_cast<float>(value);
+        return (rounded > value) ? std::nextafter(rounded, -std::numeric_limits<float>::infinity()) : rounded;
+    }
+
+    static float roundUp(double value)
+    {
+        float rounded = static_cast<float>(value);
+        return (rounded < value) ? std::nextafter(rounded, std::numeric_limits<float>::infinity()) : rounded;
+    }
+
+    void clearNode(uint32_t index)
+    {
+        WideBVHNode<Width> &node = ownedNodes_[index];
+        for (int slot = 0; slot < Width; ++slot)
+        {
+            node.minX_[slot] = node.minY_[slot] = node.minZ_[slot] = std::numeric_limits<float>::infinity();
+            node.maxX_[slot] = node.maxY_[slot] = node.maxZ_[slot] = -std::numeric_limits<float>::infinity();
+            node.child_[slot] = emptySlot;
+            node.primitiveCount_[slot] = 0;
+        }
+    }
+
+    void setChild(uint32_t index, int slot, const BVHNode &child)
+    {
+        setSlotBox(index, slot, child.boundingBox());
+        WideBVHNode<Width> &node = ownedNodes_[index];
+        if (child.isLeaf())
+        {
+            node.child_[slot] = static_cast<uint32_t>(primitives_.size());
+            node.primitiveCount_[slot] = static_cast<uint16_t>(child.primitives().size());
+            primitives_.insert(primitives_.end(), child.primitives().begin(), child.primitives().end());
+        }
+    }
+
+    void buildFrom(const BVHNode &root, const BVHBuildParameters &params = BVHBuildParameters::defaultParameters())
+    {
+        ownedNodes_.clear();
+        primitives_.clear();
+        deadNodes_ = 0;
+        box_ = root.boundingBox();
+        if (root.isLeaf())
+        {
+            // A single leaf still needs a node to hang from
+            ownedNodes_.emplace_back();
+            clearNode(0);
+            setChild(0, 0, root);
+        }
+        else
+        {
+            collapse(root, 1);
+        }
+        nodes_ = ownedNodes_;
+        buildCost_.assign(ownedNodes_.size(), 0.0);
+        cost_.assign(ownedNodes_.size(), 0.0);
+        if (!primitives_.empty())
+            measureBuildCost(0, params);
+    }
+
+    void rebuildAll(const BVHBuildParameters &params)
+    {
+        std::vector<Object *> objects = mutablePrimitives(0, primitives_.size());
+        Arena arena;
+        BVHNode root(objects, 0, objects.size(), arena, params);
+        buildFrom(root, params);
+    }
+
+    // BVHNode takes mutable pointers because leaves share its storage type; it only reorders them
+    std::vector<Object *> mutablePrimitives(size_t first, size_t end) const
+    {
+        std::vector<Object *> objects;
+        objects.reserve(end - first);
+        for (size_t i = first; i < end; ++i)
+            objects.push_back(const_cast<Object *>(primitives_[i]));
+        return objects;
+    }
+
+    // Records the cost of the subtree at index, whose nodes were just appended, as the one later refits compare against
+    void measureBuildCost(uint32_t index, const BVHBuildParameters &params)
+    {
+        refitNode(index, params);
+        for (size_t i = index; i < ownedNodes_.size(); ++i)
+            buildCost_[i] = cost_[i];
+    }
+
+    struct RefitResult
+    {
+        AABB box_;
+        double cost_; // Expected cost of a ray that hits box_, relative to one primitive test
+    };
+
+    RefitResult refitNode(uint32_t index, const BVHBuildParameters &params)
+    {
+        AABB nodeBox = AABB::emptyBox();
+        AABB slotBoxes[Width];
+        double slotCosts[Width];
+        int slotCount = 0;
+        for (int slot = 0; slot < Width; ++slot)
+        {
+            const WideBVHNode<Width> &node = ownedNodes_[index];
+            if (node.child_[slot] == emptySlot && node.primitiveCount_[slot] == 0)
+                continue;
+            AABB box = AABB::emptyBox();
+            double cost;
+            if (node.primitiveCount_[slot] > 0)
+            {
+                for (uint32_t i = 0; i < node.primitiveCount_[slot]; ++i)
+                    box = surroundingBox(box, primitives_[node.child_[slot] + i]->boundingBox());
+                cost = params.intersectionCost_ * node.primitiveCount_[slot];
+            }
+            else
+            {
+                RefitResult child = refitNode(node.child_[slot], params);
+                box = child.box_;
+                cost = params.traversalCost_ + child.cost_;
+            }
+            setSlotBox(index, slot, box);
+            nodeBox = surroundingBox(nodeBox, box);
+            slotBoxes[slotCount] = box;
+            slotCosts[slotCount++] = cost;
+        }
+
+        double area = nodeBox.surfaceArea();
+        double cost = 0.0;
+        for (int i = 0; i < slotCount; ++i)
+            cost += (area > 0.0 ? slotBoxes[i].surfaceArea() / area : 1.0) * slotCosts[i];
+        cost_[index] = cost;
+        return {nodeBox, cost};
+    }
+
+    // Top down, so the largest degraded subtree is rebuilt once rather than its pieces one by one
+    int rebuildDegraded(uint32_t index, int depth, const BVHBuildParameters &params)
+    {
+        int rebuilt = 0;
+        for (int slot = 0; slot < Width; ++slot)
+        {
+            const WideBVHNode<Width> &node = ownedNodes_[index];
+            if (node.primitiveCount_[slot] > 0 || node.child_[slot] == emptySlot)
+                continue;
+            uint32_t child = node.child_[slot];
+            if (cost_[child] > params.refitRebuildThreshold_ * buildCost_[child])
+            {
+                rebuildSubtree(index, slot, depth + 1, params);
+                ++rebuilt;
+            }
+            else
+            {
+                rebuilt += rebuildDegraded(child, depth + 1, params);
+            }
+        }
+        return rebuilt;
+    }
+
+    // A subtree's nodes and primitives were appended together by collapse(), and rebuilds keep it that way,
+    // so its primitives are one contiguous range
+    void subtreeExtent(uint32_t index, size_t &first, size_t &end, size_t &nodeCount) const
+    {
+        ++nodeCount;
+        const WideBVHNode<Width> &node = ownedNodes_[index];
+        for (int slot = 0; slot < Width; ++slot)
+        {
+            if (node.primitiveCount_[slot] > 0)
+            {
+                first = std::min<size_t>(first, node.child_[slot]);
+                end = std::max<size_t>(end, node.child_[slot] + node.primitiveCount_[slot]);
+            }
+            else if (node.child_[slot] != emptySlot)
+            {
+                subtreeExtent(node.child_[slot], first, end, nodeCount);
+            }
+        }
+    }
+
+    // Replaces the subtree in (parent, slot) with a fresh build over the same primitives. Its primitives are
+    // rewritten in place; its new nodes are appended and the old ones are left unreachable.
+    void rebuildSubtree(uint32_t parent, int slot, int depth, const BVHBuildParameters &params)
+    {
+        size_t first = primitives_.size(), end = 0, oldNodeCount = 0;
+        subtreeExtent(ownedNodes_[parent].child_[slot], first, end, oldNodeCount);
+
+        std::vector<Object *> objects = mutablePrimitives(first, end);
+        Arena arena;
+        BVHNode root(objects, 0, objects.size(), arena, params);
+
+        // collapse() and setChild() append the primitives; they are moved back into [first, end) below
+        size_t appendedPrimitives = primitives_.size();
+        uint32_t shift = static_cast<uint32_t>(appendedPrimitives - first);
+        uint32_t newIndex = emptySlot;
+        setChild(parent, slot, root);
+        if (root.isLeaf())
+        {
+            ownedNodes_[parent].child_[slot] -= shift;
+        }
+        else
+        {
+            uint32_t firstNewNode = static_cast<uint32_t>(ownedNodes_.size());
+            newIndex = collapse(root, depth);
+            ownedNodes_[parent].child_[slot] = newIndex;
+            for (size_t n = firstNewNode; n < ownedNodes_.size(); ++n)
+            {
+                for (int s = 0; s < Width; ++s)
+                {
+                    if (ownedNodes_[n].primitiveCount_[s] > 0)
+                        ownedNodes_[n].child_[s] -= shift;
+                }
+            }
+        }
+        std::copy(primitives_.begin() + appendedPrimitives, primitives_.end(), primitives_.begin() + first);
+        primitives_.resize(appendedPrimitives);
+
+        nodes_ = ownedNodes_;
+        deadNodes_ += oldNodeCount;
+        buildCost_.resize(ownedNodes_.size(), 0.0);
+        cost_.resize(ownedNodes_.size(), 0.0);
+        if (newIndex != emptySlot)
+            measureBuildCost(newIndex, params);
+    }
+
+    void setSlotBox(uint32_t index, int slot, const AABB &box)
+    {
+        WideBVHNode<Width> &node = ownedNodes_[index];
+        node.minX_[slot] = roundDown(box.min().x());
+        node.minY_[slot] = roundDown(box.min().y());
+        node.minZ_[slot] = roundDown(box.min().z());
+        node.maxX_[slot] = roundUp(box.max().x());
+        node.maxY_[slot] = roundUp(box.max().y());
+        node.maxZ_[slot] = roundUp(box.max().z());
+    }
+
+    // Pulls grandchildren up into this node until it has Width children, always opening the largest interior child
+    uint32_t collapse(const BVHNode &binaryNode, int depth)
+    {
+        if (depth > 64)
+            throw std::length_error("BVH is too deep for the WideBVH traversal stack");
+
+        std::vector<const BVHNode *> children{binaryNode.left(), binaryNode.right()};
+        while (static_cast<int>(children.size()) < Width)
+        {
+            int largest = -1;
+            double largestArea = -1.0;
+            for (int i = 0; i < static_cast<int>(children.size()); ++i)
+            {
+                double area = children[i]->boundingBox().surfaceArea();
+                if (!children[i]->isLeaf() && area > largestArea)
+                {
+                    largest = i;
+                    largestArea = area;
+                }
+            }
+            if (largest < 0)
+                break; // Only leaves left
+
+            const BVHNode *opened = children[largest];
+            children[largest] = opened->left();
+            children.insert(children.begin() + largest + 1, opened->right());
+        }
+
+        uint32_t index = static_cast<uint32_t>(ownedNodes_.size());
+        ownedNodes_.emplace_back();
+        clearNode(index);
+        for (int slot = 0; slot < static_cast<int>(children.size()); ++slot)
+        {
+            setChild(index, slot, *children[slot]);
+            if (!children[slot]->isLeaf())
+            {
+                uint32_t childIndex = collapse(*children[slot], depth + 1);
+                ownedNodes_[index].child_[slot] = childIndex;
+            }
+        }
+        return index;
+    }
+};
+
+using BVH4 = WideBVH<4>;
+using BVH8 = WideBVH<8>;
+
+#endif // RAYTRACER_WIDE_BVH_H
@@ -0,0 +1,367 @@
+// Microbenchmarks of the hot paths and end-to-end ray throughput on seeded sphere scenes.
+// Usage: raytracer_bench [--json results.json] [--max-primitives N] [--min-time seconds] [--image-size pixels]
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Arena.h"
+#include "Camera.h"
+#include "ImageWriter.h"
+#include "LinearBVH.h"
+#include "MaterialFactory.h"
+#include "WideBVH.h"
+
+class BenchmarkParameters
+{
+public:
+    std::string jsonFileName_{};         // Results are also written here as JSON when set
+    size_t maximumPrimitives_{1000000};  // Largest end-to-end scene; 10000000 adds the 10M scene (several GB)
+    double minimumSeconds_{0.25};        // Each microbenchmark repeats until it has run at least this long
+    int imageSize_{256};                 // Primary rays per end-to-end scene are imageSize_ squared
+    uint64_t seed_{20240601};            // Scenes and ray sets depend only on this
+    static BenchmarkParameters defaultParameters()
+    {
+        return BenchmarkParameters();
+    }
+};
+
+struct BenchmarkResult
+{
+    std::string name_;
+    uint64_t operations_{0};
+    double seconds_{0.0};
+    double nanosecondsPerOperation() const { return seconds_ * 1e9 / operations_; }
+};
+
+struct SceneResult
+{
+    size_t primitives_{0};
+    double buildSeconds_{0.0};
+    uint64_t primaryRays_{0};
+    uint64_t shadowRays_{0};
+    double primarySeconds_{0.0};
+    double shadowSeconds_{0.0};
+    double primaryMraysPerSecond() const { return primaryRays_ / primarySeconds_ * 1e-6; }
+    double shadowMraysPerSecond() const { return shadowRays_ / shadowSeconds_ * 1e-6; }
+    double totalMraysPerSecond() const { return (primaryRays_ + shadowRays_) / (primarySeconds_ + shadowSeconds_) * 1e-6; }
+};
+
+// Keeps the compiler from discarding a result that is otherwise unused
+template <typename T>
+inline void keepAlive(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+using Clock = std::chrono::steady_clock;
+
+inline double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Runs body(i) for i = 0, 1, ... in doubling batches until one batch takes at least minimumSeconds
+template <typename Function>
+BenchmarkResult measure(const std::string &name, double minimumSeconds, Function &&body)
+{
+    uint64_t batch = 1;
+    while (true)
+    {
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < batch; ++i)
+            body(i);
+        double seconds = secondsSince(start);
+        if (seconds >= minimumSeconds || batch >= (1ull << 40))
+        {
+            BenchmarkResult result{name, batch, seconds};
+            std::cout << std::left << std::setw(48) << name << std::right << std::setw(14) << std::fixed << std::setprecision(2)
+                      << result.nanosecondsPerOperation() << " ns/op  (" << batch << " ops)\n";
+            return result;
+        }
+        batch *= 2;
+    }
+}
+
+// count spheres with centres uniform in [-1, 1]^3; radii shrink with the count so the fill ratio stays the same
+std::vector<Object *> makeSphereScene(size_t count, uint64_t seed, Arena &arena, MaterialId material)
+{
+    PCG32 random(mixBits(seed), mixBits(count));
+    double radius = 0.5 / std::cbrt(static_cast<double>(count));
+    std::vector<Object *> objects;
+    objects.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        Point3 centre(2.0 * random.nextDouble() - 1.0, 2.0 * random.nextDouble() - 1.0, 2.0 * random.nextDouble() - 1.0);
+        objects.push_back(arena.create<Sphere>(centre, radius * (0.5 + random.nextDouble()), material));
+    }
+    return objects;
+}
+
+// Rays from points around the unit cube towards random points inside it
+std::vector<Ray> makeRays(size_t count, uint64_t seed)
+{
+    PCG32 random(mixBits(seed), mixBits(count + 1));
+    std::vector<Ray> rays;
+    rays.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        Point3 origin = Vector3::unitVectorFromSamples(random.nextDouble(), random.nextDouble()) * 3.0;
+        Point3 target(2.0 * random.nextDouble() - 1.0, 2.0 * random.nextDouble() - 1.0, 2.0 * random.nextDouble() - 1.0);
+        rays.emplace_back(origin, (target - origin).unitVector());
+    }
+    return rays;
+}
+
+void benchmarkPrimitives(const BenchmarkParameters &params, std::vector<BenchmarkResult> &results)
+{
+    const size_t rayMask = 4095;
+    std::vector<Ray> rays = makeRays(rayMask + 1, params.seed_);
+    Sphere sphere(Point3(0, 0, 0), 0.5, 0);
+    AABB box(Point3(-0.5, -0.5, -0.5), Point3(0.5, 0.5, 0.5));
+
+    results.push_back(measure("Sphere::intersect", params.minimumSeconds_, [&](uint64_t i)
+                              {
+                                  PrimitiveHit hit;
+                                  bool found = sphere.intersect(rays[i & rayMask], Interval(0.001, infinity), hit);
+                                  keepAlive(found); }));
+    results.push_back(measure("Sphere::rayHit", params.minimumSeconds_, [&](uint64_t i)
+                              {
+                                  auto hit = sphere.rayHit(rays[i & rayMask], Interval(0.001, infinity));
+                                  keepAlive(hit); }));
+    results.push_back(measure("Sphere::occluded", params.minimumSeconds_, [&](uint64_t i)
+                              {
+                                  bool blocked = sphere.occluded(rays[i & rayMask], Interval(0.001, infinity));
+                                  keepAlive(blocked); }));
+    results.push_back(measure("AABB::hit", params.minimumSeconds_, [&](uint64_t i)
+                              {
+                                  bool found = box.hit(rays[i & rayMask], Interval(0.001, infinity));
+                                  keepAlive(found); }));
+}
+
+void benchmarkBVH(const BenchmarkParameters &params, std::vector<BenchmarkResult> &results)
+{
+    const size_t sphereCount = 100000;
+    const std::string suffix = ", " + std::to_string(sphereCount) + " spheres";
+    Arena arena;
+    std::vector<Object *> objects = makeSphereScene(sphereCount, params.seed_, arena, 0);
+
+    results.push_back(measure("BVHNode build" + suffix, params.minimumSeconds_, [&](uint64_t)
+                              {
+                                  std::vector<Object *> order = objects;
+                                  BVHNode tree(order, 0, order.size());
+                                  keepAlive(tree); }));
+
+    std::vector<Object *> order = objects;
+    BVHNode tree(order, 0, order.size());
+    LinearBVH linear(tree);
+    WideBVH<preferredBVHWidth> wide(tree);
+
+    const size_t rayMask = 65535;
+    std::vector<Ray> rays = makeRays(rayMask + 1, params.seed_ + 1);
+    auto closestHit = [&](const std::string &name, const Object &world)
+    {
+        results.push_back(measure(name + "::intersect" + suffix, params.minimumSeconds_, [&](uint64_t i)
+                                  {
+                                      PrimitiveHit hit;
+                                      bool found = world.intersect(rays[i & rayMask], Interval(0.001, infinity), hit);
+                                      keepAlive(found); }));
+        results.push_back(measure(name + "::occluded" + suffix, params.minimumSeconds_, [&](uint64_t i)
+                                  {
+                                      bool blocked = world.occluded(rays[i & rayMask], Interval(0.001, infinity));
+                                      keepAlive(blocked); }));
+    };
+    closestHit("BVHNode", tree);
+    closestHit("LinearBVH", linear);
+    closestHit("WideBVH<" + std::to_string(preferredBVHWidth) + ">", wide);
+}
+
+void benchmarkMaterials(const BenchmarkParameters &params, std::vector<BenchmarkResult> &results)
+{
+    MaterialTable materials;
+    std::pair<std::string, MaterialId> entries[] = {
+        {"PureDiffuse", MaterialFactory::createDiffuse(materials, Color3(0.8, 0.2, 0.2))},
+        {"Reflective", MaterialFactory::createReflective(materials, Color3(1, 0.6, 0.8))},
+        {"Glossy", MaterialFactory::createGlossy(materials, Color3(1.0, 0.84, 0.0), 0.5)},
+        {"Checker", MaterialFactory::createChecker(materials, Color3(0, 0, 0), Color3(1, 1, 1), 10.0)},
+        {"Dielectric", MaterialFactory::createDielectric(materials, 1.5)},
+        {"Emissive", MaterialFactory::createEmissive(materials, Color3(4, 4, 4))}};
+
+    // Hit records on a unit sphere, seen by the shared ray set
+    const size_t rayMask = 4095;
+    std::vector<Ray> rays = makeRays(rayMask + 1, params.seed_ + 2);
+    Sphere sphere(Point3(0, 0, 0), 1.0, 0);
+    std::vector<std::pair<Ray, HitRecord>> hits;
+    for (const Ray &ray : rays)
+    {
+        if (auto hit = sphere.rayHit(ray, Interval(0.001, infinity)))
+            hits.emplace_back(ray, *hit);
+    }
+    size_t hitCount = hits.size();
+
+    seedRandom(params.seed_, 0);
+    for (const auto &[name, id] : entries)
+    {
+        const Material &material = materials[id];
+        results.push_back(measure("shadeMaterial " + name, params.minimumSeconds_, [&](uint64_t i)
+                                  {
+                                      const auto &[ray, hit] = hits[i % hitCount];
+                                      MaterialSample sample = shadeMaterial(material, ray, hit);
+                                      keepAlive(sample); }));
+    }
+}
+
+void benchmarkImageOutput(const BenchmarkParameters &params, std::vector<BenchmarkResult> &results)
+{
+    const int size = 512;
+    Image image{size, size, {}, true};
+    image.pixels_.resize(static_cast<size_t>(size) * size * 3);
+    PCG32 random(params.seed_, 3);
+    for (float &value : image.pixels_)
+        value = static_cast<float>(random.nextDouble());
+
+    const std::string suffix = " " + std::to_string(size) + "x" + std::to_string(size);
+    results.push_back(measure("ImageWriter::encodePPM" + suffix, params.minimumSeconds_, [&](uint64_t)
+                              { keepAlive(ImageWriter::encodePPM(image)); }));
+    results.push_back(measure("ImageWriter::encodePFM" + suffix, params.minimumSeconds_, [&](uint64_t)
+                              { keepAlive(ImageWriter::encodePFM(image)); }));
+    results.push_back(measure("ImageWriter::encodePNG" + suffix, params.minimumSeconds_, [&](uint64_t)
+                              { keepAlive(ImageWriter::encodePNG(image)); }));
+
+    // The full output path of Renderer::writeOutput: encode and write the file
+    std::string fileName = (std::filesystem::temp_directory_path() / "raytracer_bench.ppm").string();
+    results.push_back(measure("ImageWriter::write PPM" + suffix, params.minimumSeconds_, [&](uint64_t)
+                              { ImageWriter::write(image, fileName); }));
+    std::filesystem::remove(fileName);
+}
+
+// One primary ray per pixel into the scene, then one shadow ray from every hit towards a point light
+SceneResult benchmarkScene(size_t sphereCount, const BenchmarkParameters &params)
+{
+    SceneResult result;
+    result.primitives_ = sphereCount;
+
+    Arena arena;
+    std::vector<Object *> objects = makeSphereScene(sphereCount, params.seed_, arena, 0);
+    auto buildStart = Clock::now();
+    BVHNode tree(objects, 0, objects.size(), arena);
+    WideBVH<preferredBVHWidth> world(tree);
+    result.buildSeconds_ = secondsSince(buildStart);
+
+    int size = params.imageSize_;
+    Camera camera(Point3(0, 0, 3), Point3(0, 0, 2), size, 1.0);
+    std::vector<Point3> hitPoints;
+    hitPoints.reserve(static_cast<size_t>(size) * size);
+
+    auto primaryStart = Clock::now();
+    for (int j = 0; j < size; ++j)
+    {
+        for (int i = 0; i < size; ++i)
+        {
+            if (auto hit = world.rayHit(camera.getRay(i, j), Interval(0.001, infinity)))
+                hitPoints.push_back(hit->hitPoint());
+        }
+    }
+    result.primarySeconds_ = secondsSince(primaryStart);
+    result.primaryRays_ = static_cast<uint64_t>(size) * size;
+
+    const Point3 lightPosition(2.0, 3.0, 3.0);
+    size_t blocked = 0;
+    auto shadowStart = Clock::now();
+    for (const Point3 &point : hitPoints)
+    {
+        if (world.occluded(Ray(point, lightPosition - point), Interval(0.001, 0.999)))
+            ++blocked;
+    }
+    result.shadowSeconds_ = secondsSince(shadowStart);
+    result.shadowRays_ = hitPoints.size();
+    keepAlive(blocked);
+
+    std::cout << std::left << std::setw(12) << sphereCount << std::right << std::fixed << std::setprecision(3)
+              << "build " << std::setw(8) << result.buildSeconds_ << " s   primary " << std::setw(8) << result.primaryMraysPerSecond()
+              << "  shadow " << std::setw(8) << result.shadowMraysPerSecond() << "  total " << std::setw(8) << result.totalMraysPerSecond()
+              << " Mrays/s\n";
+    return result;
+}
+
+void writeJson(const std::string &fileName, const BenchmarkParameters &params,
+               const std::vector<BenchmarkResult> &benchmarks, const std::vector<SceneResult> &scenes)
+{
+    std::ofstream out(fileName);
+    if (!out)
+        throw std::runtime_error("cannot open " + fileName + " for writing");
+    out << std::setprecision(9);
+    out << "{\n";
+    out << "  \"precision\": \"" << (sizeof(Real) == sizeof(float) ? "float" : "double") << "\",\n";
+    out << "  \"bvhWidth\": " << preferredBVHWidth << ",\n";
+    out << "  \"seed\": " << params.seed_ << ",\n";
+    out << "  \"imageSize\": " << params.imageSize_ << ",\n";
+    out << "  \"microbenchmarks\": [\n";
+    for (size_t i = 0; i < benchmarks.size(); ++i)
+    {
+        const BenchmarkResult &b = benchmarks[i];
+        out << "    {\"name\": \"" << b.name_ << "\", \"operations\": " << b.operations_ << ", \"seconds\": " << b.seconds_
+            << ", \"nanosecondsPerOperation\": " << b.nanosecondsPerOperation() << "}" << (i + 1 < benchmarks.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n";
+    out << "  \"scenes\": [\n";
+    for (size_t i = 0; i < scenes.size(); ++i)
+    {
+        const SceneResult &s = scenes[i];
+        out << "    {\"primitives\": " << s.primitives_ << ", \"buildSeconds\": " << s.buildSeconds_
+            << ", \"primaryRays\": " << s.primaryRays_ << ", \"shadowRays\": " << s.shadowRays_
+            << ", \"primaryMraysPerSecond\": " << s.primaryMraysPerSecond() << ", \"shadowMraysPerSecond\": " << s.shadowMraysPerSecond()
+            << ", \"totalMraysPerSecond\": " << s.totalMraysPerSecond() << "}" << (i + 1 < scenes.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+    if (!out)
+        throw std::runtime_error("failed writing " + fileName);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchmarkParameters params = BenchmarkParameters::defaultParameters();
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--json" && hasValue)
+            params.jsonFileName_ = argv[++i];
+        else if (argument == "--max-primitives" && hasValue)
+            params.maximumPrimitives_ = std::stoull(argv[++i]);
+        else if (argument == "--min-time" && hasValue)
+            params.minimumSeconds_ = std::stod(argv[++i]);
+        else if (argument == "--image-size" && hasValue)
+            params.imageSize_ = std::stoi(argv[++i]);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--json file] [--max-primitives N] [--min-time seconds] [--image-size pixels]\n";
+            return 1;
+        }
+    }
+
+    std::cout << "Precision: " << (sizeof(Real) == sizeof(float) ? "float" : "double")
+              << ", " << preferredBVHWidth << "-wide BVH nodes, single thread\n\n";
+
+    std::vector<BenchmarkResult> benchmarks;
+    benchmarkPrimitives(params, benchmarks);
+    benchmarkBVH(params, benchmarks);
+    benchmarkMaterials(params, benchmarks);
+    benchmarkImageOutput(params, benchmarks);
+
+    std::cout << "\nEnd to end, " << params.imageSize_ << "x" << params.imageSize_ << " primary rays plus one shadow ray per hit\n";
+    std::vector<SceneResult> scenes;
+    for (size_t count = 10; count <= params.maximumPrimitives_ && count <= 10000000; count *= 10)
+        scenes.push_back(benchmarkScene(count, params));
+
+    if (!params.jsonFileName_.empty())
+    {
+        writeJson(params.jsonFileName_, params, benchmarks, scenes);
+        std::cout << "\nResults written to " << params.jsonFileName_ << "\n";
+    }
+    return 0;
+}
@@ -1,11 +1,196 @@
+#include <charconv>
+#include <chrono>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
-#include "BVHNode.h"
+#include "Animation.h"
+#include "Checkpoint.h"
+#include "Instance.h"
+#include "MeshLoader.h"
+#include "SceneLoader.h"
+#include "WideBVH.h"
 #include "Renderer.h"
 #include "MaterialFactory.h"
 
-int main()
+// Command-line options that may follow a scene file
+struct SceneOptions
 {
+    int threadCount_{-1};            // --threads <n>: overrides the scene's thread count
+    std::string coordinatorAddress_; // --coordinator <address>: hand tiles out to worker processes
+    std::string workerAddress_;      // --worker <address>: render tiles for the coordinator there
+    int spawnWorkers_{0};            // --workers <n>: the coordinator starts n workers itself
+    double stallSeconds_{30.0};      // --stall <seconds>: tiles held this long without any result are reassigned
+};
+
+// Renders a scene file, or every frame of its animation; BVHs are reused from its cache when that is up to date
+int renderSceneFile(const std::string &path, const SceneOptions &options, const char *executable)
+{
+    auto loadStart = std::chrono::steady_clock::now();
+    std::unique_ptr<SceneDescription> scene = SceneLoader::load(path);
+    double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+    std::cout << "Loaded " << path << " (" << scene->objects_.size() << " objects, "
+              << (scene->loadedFromCache_ ? "BVHs from cache" : "BVHs built and cached") << ") in " << loadSeconds << " s\n";
+    if (options.threadCount_ >= 0)
+        scene->renderParameters_.threadCount_ = options.threadCount_;
+
+    LightSampler lights(scene->objects_, scene->materials_);
+    std::cout << "Found " << lights.size() << " light(s)\n";
+
+    if (!scene->animation_.empty())
+    {
+        if (!options.coordinatorAddress_.empty() || !options.workerAddress_.empty())
+        {
+            std::cerr << "Animations are rendered in one process only\n";
+            return 1;
+        }
+        renderAnimation(scene->animation_, scene->objects_, scene->materials_, scene->camera_, scene->renderParameters_);
+        return 0;
+    }
+    if (scene->renderParameters_.streamOutput_ && (!options.coordinatorAddress_.empty() || !options.workerAddress_.empty()))
+    {
+        std::cerr << "Streamed output is written by a single process\n";
+        return 1;
+    }
+    Renderer renderer(scene->camera_, scene->renderParameters_);
+#if !defined(_WIN32)
+    if (!options.workerAddress_.empty())
+    {
+        TileWorkerConnection connection(options.workerAddress_, renderer.frameSignature(), renderer.threadCount());
+        renderer.renderForCoordinator(*scene->world_, scene->materials_, lights, connection);
+        return 0;
+    }
+    if (!options.coordinatorAddress_.empty())
+    {
+        TileCoordinator coordinator(options.coordinatorAddress_, options.stallSeconds_);
+        std::vector<std::string> workerCommand{executable, path, "--worker", options.coordinatorAddress_};
+        if (options.threadCount_ >= 0)
+            workerCommand.insert(workerCommand.end(), {"--threads", std::to_string(options.threadCount_)});
+        coordinator.spawnWorkers(options.spawnWorkers_, workerCommand);
+        renderer.renderWithWorkers(coordinator);
+        return 0;
+    }
+#else
+    (void)executable;
+    if (!options.coordinatorAddress_.empty() || !options.workerAddress_.empty())
+    {
+        std::cerr << "Distributed rendering needs POSIX sockets, which this build does not have\n";
+        return 1;
+    }
+#endif
+    renderer.render(*scene->world_, scene->materials_, lights);
+    return 0;
+}
+
+// The whole of text as a number, with no sign or trailing characters that from_chars would stop at
+template <typename T>
+bool parseOptionNumber(const std::string &text, T &value)
+{
+    auto [next, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && next == text.data() + text.size();
+}
+
+// False, after saying why, if an option is unknown, lacks its value or has an invalid one
+bool parseSceneOptions(int argc, char *argv[], SceneOptions &options)
+{
+    auto usage = [&]()
+    {
+        std::cerr << "Usage: " << argv[0] << " <file.scene> [--threads n] [--coordinator address [--workers n] [--stall seconds] | --worker address]\n";
+        return false;
+    };
+    for (int a = 2; a < argc; ++a)
+    {
+        std::string option = argv[a];
+        if (a + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << option << "\n";
+            return usage();
+        }
+        std::string value = argv[++a];
+        bool valid = true;
+        if (option == "--threads")
+            valid = parseOptionNumber(value, options.threadCount_) && options.threadCount_ >= 0;
+        else if (option == "--coordinator")
+            options.coordinatorAddress_ = value;
+        else if (option == "--worker")
+            options.workerAddress_ = value;
+        else if (option == "--workers")
+            valid = parseOptionNumber(value, options.spawnWorkers_) && options.spawnWorkers_ >= 0;
+        else if (option == "--stall")
+            valid = parseOptionNumber(value, options.stallSeconds_) && options.stallSeconds_ > 0.0;
+        else
+        {
+            std::cerr << "Unknown option " << option << "\n";
+            return usage();
+        }
+        if (!valid)
+        {
+            std::cerr << "Invalid value '" << value << "' for " << option << "\n";
+            return usage();
+        }
+    }
+    return true;
+}
+
+// Adds up checkpoints of runs with different seeds. A .checkpoint output can be merged or inspected again;
+// anything else is written as an image, with the AOV passes as extra layers when it is .exr.
+int mergeCheckpoints(const std::string &output, const std::vector<std::string> &inputs)
+{
+    RenderCheckpoint merged = RenderCheckpoint::read(inputs.front());
+    for (size_t i = 1; i < inputs.size(); ++i)
+        merged.merge(RenderCheckpoint::read(inputs[i]));
+    std::cout << "Merged " << merged.header_.mergedRuns_ << " run(s): " << merged.header_.samplesPerPixel_ << " samples per pixel\n";
+
+    if (std::filesystem::path(output).extension() == ".checkpoint")
+    {
+        merged.write(output);
+        return 0;
+    }
+    Image image{static_cast<int>(merged.header_.width_), static_cast<int>(merged.header_.height_), merged.averagePixels(), true};
+    if (imageFormatFor(output) == ImageFormat::EXR && merged.aovs_.enabled())
+    {
+        LayeredImage layers = ImageWriter::toLayers(image);
+        merged.aovs_.addLayers(layers);
+        ImageWriter::save(ImageWriter::encodeEXR(layers), output);
+    }
+    else
+    {
+        ImageWriter::write(image, output);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 3 && std::string(argv[1]) == "--merge")
+    {
+        try
+        {
+            return mergeCheckpoints(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+        }
+        catch (const std::exception &e) // Unreadable or mismatched checkpoints, or an unwritable output
+        {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    // A .scene file replaces the built-in scene below
+    if (argc > 1 && std::filesystem::path(argv[1]).extension() == ".scene")
+    {
+        SceneOptions options;
+        if (!parseSceneOptions(argc, argv, options))
+            return 1;
+        try
+        {
+            return renderSceneFile(argv[1], options, argv[0]);
+        }
+        catch (const std::exception &e) // Scene errors already name the file and line
+        {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+
     int imageWidth = 512;
     int imageHeight = 512;
 
@@ -14,38 +199,78 @@ int main()
         Point3(0, 0, -1.5),
         512, 1.0);
 
+    // Primitives and instances are allocated from one scene arena and released together
+    Arena sceneArena;
+    Pool<Instance> instancePool(sceneArena);
+
     // Create materials of diffuse and reflective types
-    const Material *greenDiffuse = MaterialFactory::createDiffuse(Color3(0.3, 0.8, 0.3));                             // green color
-    const Material *greenGlossy = MaterialFactory::createGlossy(Color3(0.2, 0.8, 0.2), 0.1);                          // glossy green color
-    const Material *redDiffuse = MaterialFactory::createDiffuse(Color3(0.8, 0.2, 0.2));                               // red color
-    const Material *pinkMirror = MaterialFactory::createReflective(Color3(1, 0.6, 0.8));                              // pink color
-    const Material *goldGlossy = MaterialFactory::createGlossy(Color3(1.0, 0.84, 0.0), 0.5);                          // gold color with slight glossiness
-    const Material *sunEmissive = MaterialFactory::createEmissive(Color3(0.9, 0.84, 0.48));                           // sun color (light source)
-    const Material *caroChecker = MaterialFactory::createChecker(Color3(0.4, 0.2, 0.1), Color3(0.8, 0.6, 0.3), 10.0); // Caro checker
-    const Material *dielectric = MaterialFactory::createDielectric(2.417);                                            // Diamond-like material with high refractive index
-    const Material *caroChecker2 = MaterialFactory::createChecker(Color3(0, 0, 0), Color3(1, 1, 1), 10.0);            // Inverted caro checker
+    MaterialTable materials;
+    MaterialId greenDiffuse = MaterialFactory::createDiffuse(materials, Color3(0.3, 0.8, 0.3));                             // green color
+    MaterialId greenGlossy = MaterialFactory::createGlossy(materials, Color3(0.2, 0.8, 0.2), 0.1);                          // glossy green color
+    MaterialId redDiffuse = MaterialFactory::createDiffuse(materials, Color3(0.8, 0.2, 0.2));                               // red color
+    MaterialId pinkMirror = MaterialFactory::createReflective(materials, Color3(1, 0.6, 0.8));                              // pink color
+    MaterialId goldGlossy = MaterialFactory::createGlossy(materials, Color3(1.0, 0.84, 0.0), 0.5);                          // gold color with slight glossiness
+    MaterialId sunEmissive = MaterialFactory::createEmissive(materials, Color3(0.9, 0.84, 0.48));                           // sun color (light source)
+    MaterialId caroChecker = MaterialFactory::createChecker(materials, Color3(0.4, 0.2, 0.1), Color3(0.8, 0.6, 0.3), 10.0); // Caro checker
+    MaterialId dielectric = MaterialFactory::createDielectric(materials, 2.417);                                            // Diamond-like material with high refractive index
+    MaterialId caroChecker2 = MaterialFactory::createChecker(materials, Color3(0, 0, 0), Color3(1, 1, 1), 10.0);            // Inverted caro checker
 
     // Create objects list for BVH tree
     std::vector<Object *> objects;
 
     // Emissive sphere (light source)
-    Sphere *lightSphere = new Sphere(Point3(0.0, 0.7, -1.5), 0.1, sunEmissive); // Light source sphere
-    objects.push_back(lightSphere);
+    objects.push_back(sceneArena.create<Sphere>(Point3(0.0, 0.7, -1.5), 0.1, sunEmissive)); // Light source sphere
 
     // Add spheres with different materials
-    objects.push_back(new Sphere(Point3(-0.75, -0.3, -1), 0.2, redDiffuse));
-    objects.push_back(new Sphere(Point3(-0.25, -0.3, -1), 0.2, dielectric));
-    objects.push_back(new Sphere(Point3(0.25, -0.3, -1), 0.2, goldGlossy));
-    objects.push_back(new Sphere(Point3(0.75, -0.3, -1), 0.2, pinkMirror));
-    objects.push_back(new Sphere(Point3(-0.75, -0.25, -2), 0.25, greenDiffuse)); // Green sphere
-    objects.push_back(new Sphere(Point3(0, -0.25, -2), 0.25, caroChecker2));  // Glossy green sphere
-    objects.push_back(new Sphere(Point3(0.75, -0.25, -2), 0.25, greenGlossy));   // Glossy green sphere
+    objects.push_back(sceneArena.create<Sphere>(Point3(-0.75, -0.3, -1), 0.2, redDiffuse));
+    objects.push_back(sceneArena.create<Sphere>(Point3(-0.25, -0.3, -1), 0.2, dielectric));
+    objects.push_back(sceneArena.create<Sphere>(Point3(0.25, -0.3, -1), 0.2, goldGlossy));
+    objects.push_back(sceneArena.create<Sphere>(Point3(0.75, -0.3, -1), 0.2, pinkMirror));
+    objects.push_back(sceneArena.create<Sphere>(Point3(-0.75, -0.25, -2), 0.25, greenDiffuse)); // Green sphere
+    objects.push_back(sceneArena.create<Sphere>(Point3(0, -0.25, -2), 0.25, caroChecker2));  // Glossy green sphere
+    objects.push_back(sceneArena.create<Sphere>(Point3(0.75, -0.25, -2), 0.25, greenGlossy));   // Glossy green sphere
 
     // Ground plane
-    objects.push_back(new Plane(Point3(0, -0.5, 0), caroChecker)); // Large ground plane
+    objects.push_back(sceneArena.create<Plane>(Point3(0, -0.5, 0), caroChecker)); // Large ground plane
+
+    // Optional OBJ or PLY mesh given on the command line. Its triangles get their own bottom-level BVH,
+    // which is shared by three instances placed between the two rows of spheres.
+    std::unique_ptr<TriangleMesh> mesh;
+    std::unique_ptr<WideBVH<preferredBVHWidth>> meshBVH;
+    if (argc > 1)
+    {
+        auto loadStart = std::chrono::steady_clock::now();
+        mesh = MeshLoader::loadMesh(argv[1], redDiffuse);
+        double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+        std::cout << "Loaded " << mesh->triangleCount() << " triangles from " << argv[1] << " in " << loadSeconds << " s\n";
+        mesh->fitToBox(Point3(0, 0, 0), 1.0);
+
+        std::vector<Object *> triangles;
+        mesh->appendTriangles(triangles);
+        BVHNode meshTree(triangles, 0, triangles.size());
+        meshBVH = std::make_unique<WideBVH<preferredBVHWidth>>(meshTree);
+
+        for (int i = -1; i <= 1; ++i)
+        {
+            Transform placement = Transform::translation(Vector3(0.6 * i, 0.1, -1.5)) *
+                                  Transform::rotation(Vector3(0, 1, 0), 30.0 * i) *
+                                  Transform::scale(0.35);
+            objects.push_back(instancePool.create(meshBVH.get(), placement));
+        }
+    }
+
+    // Every emissive sphere, and every emissive triangle of the instanced meshes, becomes a light for direct lighting
+    LightSampler lights(objects, materials);
+    std::cout << "Found " << lights.size() << " light(s)\n";
 
     // Build BVH from objects
-    Object *world = new BVHNode(objects, 0, objects.size());
+    BVHNode bvh(objects, 0, objects.size());
+    std::cout << "BVH SAH cost: " << bvh.sahCost() << "\n";
+    WideBVH<preferredBVHWidth> world(bvh);
+    std::cout << "Using " << preferredBVHWidth << "-wide BVH nodes\n";
+    const ArenaStatistics &arenaStatistics = sceneArena.statistics();
+    std::cout << "Scene arena: " << arenaStatistics.allocationCount_ << " allocations, " << arenaStatistics.bytesUsed_
+              << " bytes used of " << arenaStatistics.bytesReserved_ << " in " << arenaStatistics.blockCount_ << " block(s)\n";
 
     // Setup rendering parameters
     RendererParameters params = RendererParameters::defaultParameters();
@@ -55,7 +280,7 @@ int main()
 
     // Render
     Renderer renderer(camera, params);
-    renderer.render(*world, lightSphere);
+    renderer.render(world, materials, lights);
 
     return 0;
 }
\ No newline at end of file